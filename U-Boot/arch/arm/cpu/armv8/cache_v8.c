@@ -70,8 +70,14 @@ __weak void mmu_setup(void)
 	// printf ( "in MMU SETUP, start = %08lx\n", start );
 	// printf ( "in MMU SETUP, end = %08lx\n", end );
 		for (j = start >> SECTION_SHIFT; j < end >> SECTION_SHIFT; j++) {
+#ifdef CONFIG_CPU_WORK
+			/* Kept coherent with the other cores */
+			set_pgtable_section (page_table, j, j << SECTION_SHIFT,
+					    MT_NORMAL, PMD_SECT_INNER_SHARE );
+#else
 			set_pgtable_section (page_table, j, j << SECTION_SHIFT,
 					    MT_NORMAL, PMD_SECT_NON_SHARE );
+#endif
 		}
 	}
 
@@ -13,6 +13,14 @@
 #include <asm/io.h>
 #include <asm/arch/nexell.h>
 #include <asm/arch/clk.h>
+#ifdef CONFIG_CPU_WORK
+#include <cpu_work.h>
+#include <fdt_support.h>
+#include <libfdt.h>
+#include <malloc.h>
+#include <linux/sizes.h>
+#include <asm/arch/cpu_work.h>
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -27,7 +35,12 @@ void cpu_base_init(void)
 	 *	     must be clear wfi jump address
 	 */
 	writel(1, ALIVEPWRGATEREG);
-	writel(0xFFFFFFFF, SCR_ARM_SECOND_BOOT);
+	/*
+	 * The secondary cores only wait for this in bl1, which starts
+	 * U-Boot in EL3; below that they belong to the secure firmware
+	 */
+	if (current_el() == 3)
+		writel(0xFFFFFFFF, SCR_ARM_SECOND_BOOT);
 
 	/* write 0xf0 on alive scratchpad reg for boot success check */
 	writel(readl(SCR_SIGNAGURE_READ) | 0xF0, (SCR_SIGNAGURE_SET));
@@ -37,6 +50,16 @@ void cpu_base_init(void)
 int arch_cpu_init(void)
 {
 	flush_dcache_all();
+#ifdef CONFIG_CPU_WORK
+	/* Coherency with the secondary cores, before the caches are on */
+	if (current_el() == 3) {
+		u64 ectlr;
+
+		asm volatile("mrs %0, S3_1_c15_c2_1" : "=r" (ectlr));
+		asm volatile("msr S3_1_c15_c2_1, %0" : : "r" (ectlr | 1 << 6));
+		isb();
+	}
+#endif
 	cpu_base_init();
 	clk_init();
 	return 0;
@@ -70,6 +93,324 @@ void reset_cpu(ulong ignored)
 	writel(sw_rst_mask, (void *)(clkpwr_reg + pwrmode));
 }
 
+#ifdef CONFIG_CPU_WORK
+#ifndef CONFIG_OF_SYSTEM_SETUP
+#error "CONFIG_CPU_WORK needs CONFIG_OF_SYSTEM_SETUP to keep the OS off the parked cores"
+#endif
+
+/* Set in cpu_work_go[] by the core that runs the job */
+#define CPU_WORK_TAKEN		(1U << 31)
+/* How long a core may take to pick up a job, and to be done with it */
+#define CPU_WORK_TAKE_MS	10
+#define CPU_WORK_DONE_MS	10000
+
+struct cpu_work_boot cpu_work_boot;
+
+static struct {
+	cpu_work_fn fn;
+	void *arg;
+	u32 gen;		/* bumped for each job */
+	int park;
+} cpu_work;
+
+static u32 cpu_work_online;	/* mask of the secondary cores */
+static u32 cpu_work_lost;	/* and of those that stopped answering */
+/* Job posted to and last job done by each core */
+static u32 cpu_work_go[CPU_WORK_CORES];
+static u32 cpu_work_done[CPU_WORK_CORES];
+/* Written by each core on its way out, with its caches off */
+u32 cpu_work_parked[ARCH_DMA_MINALIGN / sizeof(u32)]
+	__aligned(ARCH_DMA_MINALIGN);
+/* The cores were called out of bl1, so they park in U-Boot */
+static int cpu_work_released;
+static int cpu_work_woken;
+static void *cpu_work_stacks;
+/* Core and job of cpu_work_start(), until cpu_work_finish() */
+static int cpu_work_bg_cpu;
+static u32 cpu_work_bg_gen;
+
+void s5p6818_secondary_main(int cpu)
+{
+	u32 last = __atomic_load_n(&cpu_work_go[cpu], __ATOMIC_ACQUIRE);
+	u32 go;
+
+	/* Jobs are only posted to the cores seen online */
+	__atomic_fetch_or(&cpu_work_online, 1 << cpu, __ATOMIC_RELEASE);
+
+	for (;;) {
+		while ((go = __atomic_load_n(&cpu_work_go[cpu],
+					     __ATOMIC_ACQUIRE)) == last)
+			asm volatile("wfe");
+		last = go;
+		/* Unless the boot core gave up waiting and took it back */
+		if (go & CPU_WORK_TAKEN ||
+		    !__atomic_compare_exchange_n(&cpu_work_go[cpu], &last,
+						 go | CPU_WORK_TAKEN, false,
+						 __ATOMIC_ACQUIRE,
+						 __ATOMIC_ACQUIRE))
+			continue;
+		last = go | CPU_WORK_TAKEN;
+		if (cpu_work.park)
+			break;
+
+		cpu_work.fn(cpu_work.arg);
+		__atomic_store_n(&cpu_work_done[cpu], go, __ATOMIC_RELEASE);
+		mb();
+		asm volatile("sev");
+	}
+
+	__atomic_store_n(&cpu_work_done[cpu], go, __ATOMIC_RELEASE);
+	mb();
+	s5p6818_secondary_park();
+}
+
+/* Hand the job in cpu_work to the cores in @online */
+static u32 cpu_work_post(u32 online)
+{
+	u32 gen = ++cpu_work.gen & ~CPU_WORK_TAKEN;
+	int cpu;
+
+	for (cpu = 1; cpu < CPU_WORK_CORES; cpu++)
+		if (online & (1 << cpu))
+			__atomic_store_n(&cpu_work_go[cpu], gen,
+					 __ATOMIC_RELEASE);
+	mb();
+	asm volatile("sev");
+
+	return gen;
+}
+
+/*
+ * Wait for core @cpu to be done with job @gen. A core that has not taken
+ * the job within CPU_WORK_TAKE_MS gets it taken back, and -EAGAIN tells
+ * the caller to run it itself; one that does not finish it within
+ * CPU_WORK_DONE_MS gives -ETIMEDOUT. Either way the core is not used again.
+ */
+static int cpu_work_wait(int cpu, u32 gen)
+{
+	ulong start = get_timer(0);
+	ulong elapsed;
+	u32 go;
+	int ret;
+
+	while (__atomic_load_n(&cpu_work_done[cpu], __ATOMIC_ACQUIRE) != gen) {
+		elapsed = get_timer(start);
+		go = gen;
+		if (elapsed >= CPU_WORK_TAKE_MS &&
+		    __atomic_compare_exchange_n(&cpu_work_go[cpu], &go,
+						gen | CPU_WORK_TAKEN, false,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_ACQUIRE)) {
+			ret = -EAGAIN;
+			goto lost;
+		}
+		if (elapsed >= CPU_WORK_DONE_MS) {
+			ret = -ETIMEDOUT;
+			goto lost;
+		}
+		udelay(1);
+	}
+
+	return 0;
+
+lost:
+	printf("CPU%d: job not %s, core dropped\n", cpu,
+	       ret == -EAGAIN ? "taken" : "finished");
+	__atomic_fetch_and(&cpu_work_online, ~(1 << cpu), __ATOMIC_RELEASE);
+	cpu_work_lost |= 1 << cpu;
+
+	return ret;
+}
+
+/*
+ * Release the secondary cores from the loop they were parked in by bl1,
+ * and wait for them to come up. Needs the MMU: the cores share the boot
+ * core's translation tables.
+ */
+static int cpu_work_wake(void)
+{
+	struct cpu_work_boot *boot = &cpu_work_boot;
+	int el = current_el();
+	ulong start;
+
+	/* See cpu_base_init() */
+	if (!dcache_status() || el != 3 ||
+	    readl(SCR_ARM_SECOND_BOOT) != 0xFFFFFFFF)
+		return 0;
+
+	if (!cpu_work_stacks) {
+		cpu_work_stacks = memalign(16, (CPU_WORK_CORES - 1) <<
+					   CPU_WORK_STACK_SHIFT);
+		if (!cpu_work_stacks)
+			return 0;
+	}
+
+	boot->el = el << 2;
+	boot->ttbr = gd->arch.tlb_addr;
+	asm volatile("mrs %0, tcr_el3" : "=r" (boot->tcr));
+	asm volatile("mrs %0, mair_el3" : "=r" (boot->mair));
+	boot->sctlr = get_sctlr();
+	boot->gd = (ulong)gd;
+	/* CPU n starts its stack at here + n * size, the top of slot n - 1 */
+	boot->stack = (ulong)cpu_work_stacks;
+	/* Read with the MMU off */
+	flush_dcache_range((ulong)boot, (ulong)boot +
+			   roundup(sizeof(*boot), CONFIG_SYS_CACHELINE_SIZE));
+
+	cpu_work.park = 0;
+	cpu_work_released = 1;
+	writel((ulong)s5p6818_secondary_entry, SCR_ARM_SECOND_BOOT);
+	mb();
+	asm volatile("sev");
+
+	start = get_timer(0);
+	while (hweight32(__atomic_load_n(&cpu_work_online, __ATOMIC_ACQUIRE))
+	       < CPU_WORK_CORES - 1 && get_timer(start) < 10)
+		udelay(10);
+
+	/* Cores that did not make it stay where they are */
+	writel(0xFFFFFFFF, SCR_ARM_SECOND_BOOT);
+
+	debug("%s: cores up %x\n", __func__, cpu_work_online);
+
+	return hweight32(cpu_work_online);
+}
+
+int cpu_work_run(cpu_work_fn fn, void *arg)
+{
+	u32 online, gen = 0;
+	int cpu, ret, n = 1, err = 0;
+
+	cpu_work_finish();
+	if (!cpu_work_woken) {
+		cpu_work_wake();
+		cpu_work_woken = 1;
+	}
+
+	online = __atomic_load_n(&cpu_work_online, __ATOMIC_ACQUIRE);
+	cpu_work.fn = fn;
+	cpu_work.arg = arg;
+	if (online)
+		gen = cpu_work_post(online);
+
+	fn(arg);
+
+	/* A core that never took the job had no share of it either */
+	for (cpu = 1; cpu < CPU_WORK_CORES; cpu++) {
+		if (!(online & (1 << cpu)))
+			continue;
+		ret = cpu_work_wait(cpu, gen);
+		if (!ret)
+			n++;
+		else if (ret == -ETIMEDOUT)
+			err = ret;
+	}
+
+	return err ? err : n;
+}
+
+void cpu_work_start(cpu_work_fn fn, void *arg)
+{
+	u32 online;
+
+	cpu_work_finish();
+	if (!cpu_work_woken) {
+		cpu_work_wake();
+		cpu_work_woken = 1;
+	}
+
+	online = __atomic_load_n(&cpu_work_online, __ATOMIC_ACQUIRE);
+	if (!online) {
+		fn(arg);
+		return;
+	}
+
+	/* The lowest core that is up */
+	cpu_work_bg_cpu = __ffs(online);
+	cpu_work.fn = fn;
+	cpu_work.arg = arg;
+	cpu_work_bg_gen = cpu_work_post(1 << cpu_work_bg_cpu);
+}
+
+int cpu_work_finish(void)
+{
+	int cpu = cpu_work_bg_cpu;
+	int ret;
+
+	if (!cpu)
+		return 0;
+
+	cpu_work_bg_cpu = 0;
+	ret = cpu_work_wait(cpu, cpu_work_bg_gen);
+	/* Not started, so it is done here */
+	if (ret == -EAGAIN) {
+		cpu_work.fn(cpu_work.arg);
+		ret = 0;
+	}
+
+	return ret;
+}
+
+void cpu_work_park(void)
+{
+	ulong parked = (ulong)cpu_work_parked;
+	u32 online, left, gen;
+	ulong start;
+	int cpu;
+
+	cpu_work_finish();
+	online = __atomic_load_n(&cpu_work_online, __ATOMIC_ACQUIRE);
+	cpu_work_woken = 0;
+	if (!online)
+		goto out;
+
+	/* Written by the cores with their caches off */
+	memset(cpu_work_parked, 0, sizeof(cpu_work_parked));
+	flush_dcache_range(parked, parked + sizeof(cpu_work_parked));
+
+	cpu_work.park = 1;
+	gen = cpu_work_post(online);
+	for (cpu = 1; cpu < CPU_WORK_CORES; cpu++)
+		if (online & (1 << cpu))
+			cpu_work_wait(cpu, gen);
+
+	/* Until they are all in s5p6818_secondary_pen() */
+	left = __atomic_load_n(&cpu_work_online, __ATOMIC_ACQUIRE);
+	start = get_timer(0);
+	while (left && get_timer(start) < CPU_WORK_TAKE_MS) {
+		invalidate_dcache_range(parked,
+					parked + sizeof(cpu_work_parked));
+		for (cpu = 1; cpu < CPU_WORK_CORES; cpu++)
+			if (cpu_work_parked[cpu])
+				left &= ~(1 << cpu);
+		udelay(10);
+	}
+	cpu_work_lost |= left;
+	cpu_work_online = 0;
+
+out:
+	if (cpu_work_lost)
+		printf("CPU: secondary cores %x not parked\n", cpu_work_lost);
+}
+
+/* The OS releases the cores itself */
+void arch_preboot_os(void)
+{
+	cpu_work_park();
+}
+
+/* The parked cores wait in s5p6818_secondary_pen(), keep the OS off it */
+int ft_system_setup(void *blob, bd_t *bd)
+{
+	ulong pen = (ulong)s5p6818_secondary_pen;
+
+	if (!cpu_work_released)
+		return 0;
+
+	return fdt_add_mem_rsv(blob, rounddown(pen, SZ_4K), SZ_4K);
+}
+#endif /* CONFIG_CPU_WORK */
+
 #if defined(CONFIG_ARCH_MISC_INIT)
 int arch_misc_init(void)
 {
@@ -0,0 +1,44 @@
+/*
+ * ARMv8 CRC32 and SHA2 instructions
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _ASM_ARMV8_CRYPTO_H_
+#define _ASM_ARMV8_CRYPTO_H_
+
+#include <linux/types.h>
+
+/* ID_AA64ISAR0_EL1 fields */
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+#define ID_AA64ISAR0_CRC32_SHIFT	16
+
+static inline unsigned long get_id_aa64isar0(void)
+{
+	unsigned long val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+	return val;
+}
+
+static inline int armv8_has_sha256(void)
+{
+	return (get_id_aa64isar0() >> ID_AA64ISAR0_SHA2_SHIFT) & 0xf;
+}
+
+static inline int armv8_has_crc32(void)
+{
+	return (get_id_aa64isar0() >> ID_AA64ISAR0_CRC32_SHIFT) & 0xf;
+}
+
+/*
+ * Same as crc32_no_comp(): the CRC32 instructions use the reflected
+ * polynomial of zlib and no inversion.
+ */
+uint32_t crc32_armv8(uint32_t crc, const uint8_t *buf, unsigned int len);
+
+/* Run @blocks 64-byte blocks of @data through the SHA-256 @state */
+void sha256_armv8_blocks(uint32_t state[8], const uint8_t *data,
+			 unsigned int blocks);
+
+#endif /* _ASM_ARMV8_CRYPTO_H_ */
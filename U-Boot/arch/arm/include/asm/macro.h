@@ -73,6 +73,26 @@ lr	.req	x30
 	b.eq	\el1_label
 .endm
 
+/*
+ * Branch unless unaligned accesses are allowed: the MMU is on, so that RAM
+ * is Normal memory, and alignment checking (SCTLR.A) is off.
+ */
+.macro	branch_if_strict_align, xreg, strict_label
+	mrs	\xreg, CurrentEL
+	cmp	\xreg, 0xc
+	b.ne	91f
+	mrs	\xreg, sctlr_el3
+	b	93f
+91:	cmp	\xreg, 0x8
+	b.ne	92f
+	mrs	\xreg, sctlr_el2
+	b	93f
+92:	mrs	\xreg, sctlr_el1
+93:	and	\xreg, \xreg, #3	/* A, M */
+	cmp	\xreg, #1
+	b.ne	\strict_label
+.endm
+
 /*
  * Branch if current processor is a Cortex-A57 core.
  */
@@ -0,0 +1,46 @@
+/*
+ * (C) Copyright 2016 Nexell
+ *
+ * SPDX-License-Identifier:      GPL-2.0+
+ */
+
+#ifndef _NEXELL_CPU_WORK_H
+#define _NEXELL_CPU_WORK_H
+
+#define CPU_WORK_CORES			8
+#define CPU_WORK_STACK_SHIFT		14	/* 16KB per core */
+
+/* struct cpu_work_boot, as read by the secondary cores */
+#define CPU_WORK_BOOT_EL		0x00
+#define CPU_WORK_BOOT_TTBR		0x08
+#define CPU_WORK_BOOT_TCR		0x10
+#define CPU_WORK_BOOT_MAIR		0x18
+#define CPU_WORK_BOOT_SCTLR		0x20
+#define CPU_WORK_BOOT_GD		0x28
+#define CPU_WORK_BOOT_STACK		0x30
+
+#ifndef __ASSEMBLY__
+/*
+ * What a secondary core needs to join U-Boot: the boot core's exception
+ * level, translation regime and gd, and the base of the stacks.
+ */
+struct cpu_work_boot {
+	u64 el;			/* CurrentEL */
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 sctlr;
+	u64 gd;
+	u64 stack;
+};
+
+extern struct cpu_work_boot cpu_work_boot;
+extern u32 cpu_work_parked[];
+
+void s5p6818_secondary_entry(void);
+void s5p6818_secondary_main(int cpu);
+void s5p6818_secondary_park(void) __attribute__((noreturn));
+void s5p6818_secondary_pen(void) __attribute__((noreturn));
+#endif
+
+#endif /* _NEXELL_CPU_WORK_H */
@@ -0,0 +1,15 @@
+/*
+ * (C) Copyright 2016 Nexell
+ *
+ * SPDX-License-Identifier:      GPL-2.0+
+ */
+
+#ifndef _NEXELL_MMC_H
+#define _NEXELL_MMC_H
+
+int nexell_mmc_init(const void *blob);
+
+/* Keep the tuned sample points in the environment, once it is ready */
+void nexell_mmc_tuning_setenv(void);
+
+#endif
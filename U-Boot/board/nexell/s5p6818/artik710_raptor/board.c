@@ -11,6 +11,7 @@
 
 #include <asm/arch/nexell.h>
 #include <asm/arch/nx_gpio.h>
+#include <asm/arch/mmc.h>
 #include <memalign.h>
 
 #ifdef CONFIG_DM_PMIC_NXE2000
@@ -313,6 +314,9 @@ int board_late_init(void)
 #ifdef CONFIG_DM_PMIC_NXE2000
 	pmic_init();
 #endif
+#ifdef CONFIG_NEXELL_DWMMC
+	nexell_mmc_tuning_setenv();
+#endif
 #ifdef CONFIG_REVISION_TAG
 	set_board_rev(board_rev);
 #endif
@@ -9,16 +9,20 @@
 #include <common.h>
 #include <bootstage.h>
 #include <bzlib.h>
+#include <cpu_work.h>
 #include <errno.h>
 #include <fdt_support.h>
 #include <lmb.h>
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
 #include <linux/lzo.h>
+#include <linux/sizes.h>
 #include <lzma/LzmaTypes.h>
 #include <lzma/LzmaDec.h>
 #include <lzma/LzmaTools.h>
+#include <u-boot/zlib.h>
 #if defined(CONFIG_CMD_USB)
 #include <usb.h>
 #endif
@@ -412,6 +416,306 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 	return 0;
 }
 
+#ifndef USE_HOSTCC
+#define BOOTM_STREAM_STEP	SZ_1M	/* per read, and per ring buffer */
+#define BOOTM_STREAM_ARENA	SZ_64K	/* inflate state and window */
+
+/* Decompression of an image as it is read, see bootm_decomp_stream() */
+struct bootm_stream {
+	int comp;
+	void *out;
+	ulong out_len;
+	ulong done;		/* bytes decompressed */
+	int ret;		/* 0 going on, 1 at the end, or error */
+	const void *blk;	/* block for the next job */
+	ulong blk_len;
+	const void *in;		/* its data for the decoder */
+	ulong in_len;
+	void (*work)(void *priv, const void *buf, ulong len);
+	void *priv;
+#ifdef CONFIG_GZIP
+	z_stream zs;
+	char *arena;		/* inflate allocates from here, not malloc() */
+	ulong arena_used;
+#endif
+#ifdef CONFIG_LZMA
+	CLzmaDec lzma;
+	SizeT lzma_limit;	/* decompressed size, within out_len */
+	bool lzma_sized;	/* else the stream ends with a mark */
+#endif
+};
+
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+/* The decoders reset the watchdog, which only this core may do */
+static void bootm_stream_start(cpu_work_fn fn, void *arg)
+{
+	fn(arg);
+}
+#else
+#define bootm_stream_start	cpu_work_start
+#endif
+
+#ifdef CONFIG_GZIP
+static void *bootm_stream_zalloc(void *opaque, unsigned items, unsigned size)
+{
+	struct bootm_stream *bs = opaque;
+	ulong len = ALIGN(items * size, 16);
+	void *p;
+
+	if (bs->arena_used + len > BOOTM_STREAM_ARENA)
+		return NULL;
+	p = bs->arena + bs->arena_used;
+	bs->arena_used += len;
+
+	return p;
+}
+
+static void bootm_stream_zfree(void *opaque, void *addr, unsigned nb)
+{
+}
+
+static int bootm_stream_gunzip(struct bootm_stream *bs)
+{
+	z_stream *s = &bs->zs;
+	int r;
+
+	s->next_in = (void *)bs->in;
+	s->avail_in = bs->in_len;
+	r = inflate(s, Z_SYNC_FLUSH);
+	bs->done = bs->out_len - s->avail_out;
+	if (r == Z_STREAM_END)
+		return 1;
+	if (r != Z_OK)
+		return r < 0 ? r : -EINVAL;
+	/* Input left over means the output is full */
+	return s->avail_in ? -ENOSPC : 0;
+}
+#endif
+
+#ifdef CONFIG_LZMA
+static void *bootm_stream_lzma_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void bootm_stream_lzma_free(void *p, void *address)
+{
+	free(address);
+}
+
+static ISzAlloc bootm_stream_lzma_sz = {
+	bootm_stream_lzma_alloc, bootm_stream_lzma_free,
+};
+
+static int bootm_stream_unlzma(struct bootm_stream *bs)
+{
+	SizeT len = bs->in_len;
+	ELzmaStatus status;
+	SRes res;
+
+	res = LzmaDec_DecodeToDic(&bs->lzma, bs->lzma_limit, bs->in, &len,
+				  LZMA_FINISH_ANY, &status);
+	bs->done = bs->lzma.dicPos;
+	if (res != SZ_OK)
+		return -res;
+	if (status == LZMA_STATUS_FINISHED_WITH_MARK)
+		return 1;
+	if (bs->done == bs->lzma_limit)
+		return bs->lzma_sized ? 1 : -ENOSPC;
+
+	return 0;
+}
+#endif
+
+/* Job: pass a block to the caller's work, then decompress it */
+static void bootm_stream_job(void *arg)
+{
+	struct bootm_stream *bs = arg;
+
+	if (bs->work)
+		bs->work(bs->priv, bs->blk, bs->blk_len);
+	if (bs->ret || !bs->in_len)
+		return;
+
+	switch (bs->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		bs->ret = bootm_stream_gunzip(bs);
+		break;
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		bs->ret = bootm_stream_unlzma(bs);
+		break;
+#endif
+	}
+}
+
+/* Set up the decoder from the start of the image, done on this core */
+static int bootm_stream_init(struct bootm_stream *bs)
+{
+	switch (bs->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP: {
+		int offset = gzip_parse_header(bs->in, bs->in_len);
+
+		if (offset < 0)
+			return -EINVAL;
+		bs->in += offset;
+		bs->in_len -= offset;
+
+		bs->arena = malloc(BOOTM_STREAM_ARENA);
+		if (!bs->arena)
+			return -ENOMEM;
+		bs->zs.zalloc = bootm_stream_zalloc;
+		bs->zs.zfree = bootm_stream_zfree;
+		bs->zs.opaque = bs;
+		if (inflateInit2(&bs->zs, -MAX_WBITS) != Z_OK)
+			return -ENOMEM;
+		bs->zs.next_out = bs->out;
+		bs->zs.avail_out = bs->out_len;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA: {
+		const u8 *p = bs->in;
+		u64 size;
+
+		/* Properties, then the decompressed size, as in LzmaTools */
+		if (bs->in_len < LZMA_PROPS_SIZE + sizeof(u64))
+			return -EINVAL;
+		size = get_unaligned_le64(p + LZMA_PROPS_SIZE);
+		if (size != (u64)-1 && size > bs->out_len)
+			return -ENOSPC;
+		LzmaDec_Construct(&bs->lzma);
+		if (LzmaDec_AllocateProbs(&bs->lzma, p, LZMA_PROPS_SIZE,
+					   &bootm_stream_lzma_sz) != SZ_OK)
+			return -ENOMEM;
+		LzmaDec_Init(&bs->lzma);
+		bs->lzma.dic = bs->out;
+		bs->lzma.dicBufSize = bs->out_len;
+		bs->lzma_sized = size != (u64)-1;
+		bs->lzma_limit = min_t(u64, size, bs->out_len);
+		bs->in += LZMA_PROPS_SIZE + sizeof(u64);
+		bs->in_len -= LZMA_PROPS_SIZE + sizeof(u64);
+		return 0;
+	}
+#endif
+	}
+
+	return 0;
+}
+
+static void bootm_stream_end(struct bootm_stream *bs)
+{
+	switch (bs->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		if (bs->arena) {
+			inflateEnd(&bs->zs);
+			free(bs->arena);
+		}
+		break;
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		LzmaDec_FreeProbs(&bs->lzma, &bootm_stream_lzma_sz);
+		break;
+#endif
+	}
+}
+
+int bootm_decomp_stream(int comp, ulong load, void *load_buf, ulong image_len,
+			uint unc_len,
+			int (*read)(void *priv, void *buf, ulong len),
+			void (*work)(void *priv, const void *buf, ulong len),
+			void *priv, ulong *load_end)
+{
+	/* Not on the stack: a decoder core that hangs may still write it */
+	static struct bootm_stream bs;
+	void *ring[2] = { NULL, NULL };
+	void *buf;
+	ulong pos, n;
+	int i, ret = 0, hung = 0;
+
+	switch (comp) {
+	case IH_COMP_NONE:
+		if (image_len > unc_len)
+			return handle_decomp_error(comp, image_len, unc_len,
+						   -ENOSPC);
+		break;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+#endif
+		ring[0] = memalign(ARCH_DMA_MINALIGN, 2 * BOOTM_STREAM_STEP);
+		if (!ring[0])
+			return -ENOMEM;
+		ring[1] = ring[0] + BOOTM_STREAM_STEP;
+		break;
+	default:
+		return BOOTM_ERR_UNIMPLEMENTED;
+	}
+
+	memset(&bs, 0, sizeof(bs));
+	bs.comp = comp;
+	bs.out = load_buf;
+	bs.out_len = unc_len;
+	bs.work = work;
+	bs.priv = priv;
+
+	/*
+	 * Read each block while the one before it is decompressed; the ring
+	 * of two buffers is all the compressed data kept in memory
+	 */
+	for (pos = 0, i = 0; pos < image_len; pos += n, i ^= 1) {
+		n = min_t(ulong, image_len - pos, BOOTM_STREAM_STEP);
+		buf = comp == IH_COMP_NONE ? load_buf + pos : ring[i];
+		ret = read(priv, buf, n);
+		if (cpu_work_finish() < 0)
+			hung = 1;
+		if (ret || hung || bs.ret < 0)
+			break;
+
+		bs.blk = buf;
+		bs.blk_len = n;
+		bs.in = buf;
+		bs.in_len = n;
+		if (!pos)
+			bs.ret = bootm_stream_init(&bs);
+		if (bs.ret < 0)
+			break;
+		bootm_stream_start(bootm_stream_job, &bs);
+	}
+	if (cpu_work_finish() < 0)
+		hung = 1;
+
+	/* The output is incomplete and the ring may still be read */
+	if (hung)
+		return handle_decomp_error(comp, bs.done, unc_len, -ETIMEDOUT);
+
+	bootm_stream_end(&bs);
+	free(ring[0]);
+
+	if (ret)
+		return ret;
+	if (comp == IH_COMP_NONE) {
+		bs.done = image_len;
+	} else if (bs.ret != 1) {
+		/* An image that ends early is an error too */
+		return handle_decomp_error(comp, bs.ret == -ENOSPC ? unc_len :
+					   bs.done, unc_len,
+					   bs.ret ? bs.ret : -EIO);
+	}
+	*load_end = load + bs.done;
+
+	return 0;
+}
+#endif /* !USE_HOSTCC */
+
 #ifndef USE_HOSTCC
 static int bootm_load_os(bootm_headers_t *images, unsigned long *load_end,
 			 int boot_progress)
@@ -611,6 +915,11 @@ int do_bootm_states(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		ret = bootm_find_other(cmdtp, flag, argc, argv);
 		argc = 0;	/* consume the args */
 	}
+#if defined(CONFIG_FIT)
+	/* The images of the configuration are loaded, or never will be */
+	if (states & (BOOTM_STATE_FINDOS | BOOTM_STATE_FINDOTHER))
+		fit_hash_clear();
+#endif
 
 	/* Load the OS */
 	if (!ret && (states & BOOTM_STATE_LOADOS)) {
@@ -0,0 +1,78 @@
+/*
+ * Block device cache: statistics and size
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <part.h>
+
+static int do_blkcache_show(cmd_tbl_t *cmdtp, int flag, int argc,
+			    char * const argv[])
+{
+	struct block_cache_stats stats;
+
+	blkcache_stats(&stats);
+
+	printf("    hits: %u\n"
+	       "    misses: %u\n"
+	       "    entries: %u\n"
+	       "    max blocks/entry: %u\n"
+	       "    max cache entries: %u\n",
+	       stats.hits, stats.misses, stats.entries,
+	       stats.max_blocks_per_entry, stats.max_entries);
+
+	return 0;
+}
+
+static int do_blkcache_configure(cmd_tbl_t *cmdtp, int flag, int argc,
+				 char * const argv[])
+{
+	unsigned blocks, entries;
+
+	if (argc != 3)
+		return CMD_RET_USAGE;
+
+	blocks = simple_strtoul(argv[1], NULL, 0);
+	entries = simple_strtoul(argv[2], NULL, 0);
+	blkcache_configure(blocks, entries);
+
+	printf("changed to max of %u entries of %u blocks each\n",
+	       entries, blocks);
+
+	return 0;
+}
+
+static cmd_tbl_t cmd_blkcache_sub[] = {
+	U_BOOT_CMD_MKENT(show, 0, 0, do_blkcache_show, "", ""),
+	U_BOOT_CMD_MKENT(configure, 3, 0, do_blkcache_configure, "", ""),
+};
+
+static int do_blkcache(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	cmd_tbl_t *c;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	/* Strip off leading 'blkcache' command argument */
+	argc--;
+	argv++;
+
+	c = find_cmd_tbl(argv[0], cmd_blkcache_sub,
+			 ARRAY_SIZE(cmd_blkcache_sub));
+
+	if (c)
+		return c->cmd(cmdtp, flag, argc, argv);
+	else
+		return CMD_RET_USAGE;
+}
+
+U_BOOT_CMD(blkcache, 4, 0, do_blkcache,
+	"block cache diagnostics and control",
+	"show - show cache statistics\n"
+	"blkcache configure <blocks> <entries> - set the number of blocks\n"
+	"    read ahead into an entry, and the maximum number of entries"
+);
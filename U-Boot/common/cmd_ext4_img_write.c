@@ -8,11 +8,11 @@
 #include <common.h>
 #include <command.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <mmc.h>
 #include <asm/sections.h>
 #include <part.h>
-
-DECLARE_GLOBAL_DATA_PTR;
+#include <div64.h>
 
 #define MMC_BLOCK_SIZE		(512)
 #define SECTOR_BITS		9	/* 512B */
@@ -49,20 +49,36 @@ struct ext4_chunk_header {
 #define EXT4_CHUNK_TYPE_FILL		0xCAC2
 #define EXT4_CHUNK_TYPE_NONE		0xCAC3
 
-#define ALIGN_BUFFER_SIZE		0x4000000
-#define WRITE_SECTOR 65536					/* 32 MB */
+/*
+ * RAW chunks are written straight from the image with the block device
+ * write hook.  Chunks that are not DMA aligned, or that are small enough
+ * that the per-command cost dominates, are gathered into a staging buffer
+ * so that adjacent chunks go out as a single multi-block write.
+ */
+#define STAGE_BUFFER_SIZE		(4 << 20)	/* 4 MB */
+#define STAGE_SECTOR			(STAGE_BUFFER_SIZE >> SECTOR_BITS)
+#define STAGE_MERGE_SIZE		(256 << 10)	/* 256 KB */
+#define FILL_BUFFER_SIZE		(1 << 20)	/* 1 MB */
+#define FILL_SECTOR			(FILL_BUFFER_SIZE >> SECTOR_BITS)
 
 typedef int (*WRITE_RAW_CHUNK_CB)(char *data, unsigned int sector,
 				  unsigned int sector_size);
 
 int set_write_raw_chunk_cb(WRITE_RAW_CHUNK_CB cb);
-extern ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt,
-			const void *src);
 
 static int write_raw_chunk(char *data, unsigned int sector,
 			   unsigned int sector_size);
 static WRITE_RAW_CHUNK_CB write_raw_chunk_cb = write_raw_chunk;
 
+static block_dev_desc_t *img_desc;
+static unsigned char *stage_buf;
+static unsigned int stage_start;	/* first sector of the staged run */
+static unsigned int stage_cnt;		/* staged sectors */
+static unsigned char *fill_buf;
+static unsigned int fill_val;
+static uint64_t img_written;		/* bytes written to the device */
+static const void *img_pending;		/* buffer of a write still running */
+
 int set_write_raw_chunk_cb(WRITE_RAW_CHUNK_CB cb)
 {
 	write_raw_chunk_cb = cb;
@@ -117,105 +133,418 @@ int check_compress_ext4(char *img_base, unsigned long long parti_size)
 	return 0;
 }
 
-int write_raw_chunk(char *data, unsigned int sector, unsigned int sector_size)
+static int img_write_wait(void)
 {
-	char run_cmd[64];
-	unsigned char *tmp_align;
-
-	if (((unsigned long)data % 8) != 0) {
-		int offset = 0;
-
-		/* align buffer start = malloc_start_address - ALIGN_BUFFER_SIZE */
-		tmp_align = (unsigned char *)(gd->relocaddr - TOTAL_MALLOC_LEN);
-		tmp_align -= ALIGN_BUFFER_SIZE;
-
-		do {
-			if (sector_size > WRITE_SECTOR) {
-				memcpy((unsigned char *)tmp_align,
-				       (unsigned char *)data+offset,
-				       WRITE_SECTOR*512);
-
-				sprintf(run_cmd, "mmc write 0x%x 0x%x 0x%x",
-					(int)((ulong)tmp_align),
-					sector, WRITE_SECTOR);
-
-				sector_size -= WRITE_SECTOR;
-				sector += WRITE_SECTOR;
-			} else {
-				memcpy((unsigned char *)tmp_align,
-				       (unsigned char *)data+offset,
-				       sector_size * 512);
-				sprintf(run_cmd, "mmc write 0x%x 0x%x 0x%x",
-					(int)((ulong)tmp_align),
-					sector, sector_size);
-
-				sector_size -= sector_size;
-			}
-			run_command(run_cmd, 0);
+	if (!img_pending)
+		return 0;
 
-		} while (sector_size > 0);
+	img_pending = NULL;
+	if (mmc_bwrite_wait(img_desc->dev)) {
+		printf("** write fail mmc.%d **\n", img_desc->dev);
+		return -1;
+	}
 
+	return 0;
+}
+
+/*
+ * On mmc the write is only started, so that the next piece of the image
+ * can be read meanwhile: 'buf' must be left alone until img_write_wait(),
+ * which the next write does first.
+ */
+static int img_block_write(unsigned int sector, unsigned int sector_size,
+			   const void *buf)
+{
+	ulong n;
+
+	img_pending = NULL;
+	if (img_desc->if_type == IF_TYPE_MMC) {
+		n = mmc_bwrite_start(img_desc->dev, sector, sector_size, buf);
+		if (n == sector_size)
+			img_pending = buf;
+	} else {
+		n = img_desc->block_write(img_desc->dev, sector, sector_size,
+					  buf);
+	}
+	if (n != sector_size) {
+		printf("** write fail mmc.%d 0x%x(0x%x) **\n",
+		       img_desc->dev, sector, sector_size);
+		return -1;
+	}
+	img_written += (uint64_t)sector_size << SECTOR_BITS;
+
+	return 0;
+}
+
+static int stage_flush(void)
+{
+	int ret;
+
+	if (!stage_cnt)
 		return 0;
+
+	debug("write staged data in %d size %d\n", stage_start, stage_cnt);
+	ret = img_block_write(stage_start, stage_cnt, stage_buf);
+	stage_cnt = 0;
+
+	return ret;
+}
+
+static int write_raw_chunk(char *data, unsigned int sector,
+			   unsigned int sector_size)
+{
+	unsigned int n;
+
+	if (!((ulong)data & (ARCH_DMA_MINALIGN - 1)) &&
+	    (sector_size << SECTOR_BITS) > STAGE_MERGE_SIZE) {
+		if (stage_flush())
+			return -1;
+
+		debug("write raw data in %d size %d\n", sector, sector_size);
+		return img_block_write(sector, sector_size, data);
+	}
+
+	while (sector_size) {
+		if (stage_cnt && (stage_start + stage_cnt != sector ||
+				  stage_cnt == STAGE_SECTOR)) {
+			if (stage_flush())
+				return -1;
+		}
+		if (!stage_cnt) {
+			if (img_pending == stage_buf && img_write_wait())
+				return -1;
+			stage_start = sector;
+		}
+
+		n = min(sector_size, (unsigned int)STAGE_SECTOR - stage_cnt);
+		memcpy(stage_buf + (stage_cnt << SECTOR_BITS), data,
+		       n << SECTOR_BITS);
+
+		stage_cnt += n;
+		sector += n;
+		sector_size -= n;
+		data += n << SECTOR_BITS;
 	}
-	debug("write raw data in %d size %d\n", sector, sector_size);
-	sprintf(run_cmd, "mmc write 0x%x 0x%x 0x%x", (int)((ulong)data),
-		sector, sector_size);
-	run_command(run_cmd, 0);
 
 	return 0;
 }
 
-int write_compressed_ext4(char *img_base, unsigned int sector_base)
+static int write_fill_chunk(unsigned int val, unsigned int sector,
+			    unsigned int sector_size)
+{
+	unsigned int *p = (unsigned int *)fill_buf;
+	unsigned int n;
+	int i;
+
+	/* the pattern buffer is only rebuilt when the fill value changes */
+	if (val != fill_val) {
+		if (img_pending == fill_buf && img_write_wait())
+			return -1;
+		for (i = 0; i < FILL_BUFFER_SIZE / sizeof(*p); i++)
+			p[i] = val;
+		fill_val = val;
+	}
+
+	while (sector_size) {
+		n = min(sector_size, (unsigned int)FILL_SECTOR);
+		if (img_block_write(sector, n, fill_buf))
+			return -1;
+		sector += n;
+		sector_size -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Streaming parser: the image may be fed in pieces of any size (e.g. as
+ * it is read from a file system), so headers and sectors that straddle
+ * two pieces are collected in 'hold' first.
+ */
+enum {
+	STREAM_FILE_HEADER,
+	STREAM_CHUNK_HEADER,
+	STREAM_RAW,
+	STREAM_FILL,
+	STREAM_SKIP,
+	STREAM_DONE,
+};
+
+static struct ext4_file_header stream_fh;
+static struct ext4_chunk_header stream_ch;
+static int stream_state;
+static int stream_err;
+static unsigned int stream_sector;	/* next sector to write */
+static unsigned int stream_chunks;	/* chunks left */
+static unsigned int stream_remain;	/* body bytes left in the chunk */
+static unsigned char stream_hold[MMC_BLOCK_SIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+static unsigned int stream_held;
+
+static unsigned int stream_collect(const char **buf, unsigned long *len,
+				   unsigned int size)
+{
+	unsigned int n = min((unsigned long)(size - stream_held), *len);
+
+	memcpy(stream_hold + stream_held, *buf, n);
+	stream_held += n;
+	*buf += n;
+	*len -= n;
+
+	return stream_held == size;
+}
+
+static void stream_next_chunk(void)
+{
+	stream_chunks--;
+	debug("remain chunks = %d\n", stream_chunks);
+	stream_state = stream_chunks ? STREAM_CHUNK_HEADER : STREAM_DONE;
+}
+
+static void stream_chunk_header(void)
 {
 	unsigned int sector_size;
-	int total_chunks;
-	struct ext4_chunk_header *chunk_header;
-	struct ext4_file_header *file_header;
 
-	file_header = (struct ext4_file_header *)img_base;
-	total_chunks = file_header->total_chunks;
+	sector_size = (stream_ch.chunk_size * stream_fh.block_size)
+		>> SECTOR_BITS;
+	stream_remain = stream_ch.total_size - EXT4_CHUNK_HEADER_SIZE;
+
+	switch (stream_ch.type) {
+	case EXT4_CHUNK_TYPE_RAW:
+		debug("raw_chunk\n");
+		stream_state = STREAM_RAW;
+		break;
+
+	case EXT4_CHUNK_TYPE_FILL:
+		debug("fill_chunk\n");
+		stream_state = STREAM_FILL;
+		break;
+
+	case EXT4_CHUNK_TYPE_NONE:
+		/* don't care: leave the device contents as they are */
+		debug("none chunk\n");
+		stream_sector += sector_size;
+		stream_state = STREAM_SKIP;
+		break;
+
+	default:
+		printf("*** unknown chunk type ***\n");
+		stream_sector += sector_size;
+		stream_state = STREAM_SKIP;
+		break;
+	}
 
-	debug("total chunk = %d\n", total_chunks);
+	if (!stream_remain && stream_state != STREAM_FILL)
+		stream_next_chunk();
+}
 
-	img_base += EXT4_FILE_HEADER_SIZE;
+static int stream_raw(const char **buf, unsigned long *len)
+{
+	unsigned long n = min((unsigned long)stream_remain, *len);
+	unsigned int cnt;
+
+	/* complete a sector that started in the previous piece */
+	if (stream_held) {
+		n = min(n, (unsigned long)(MMC_BLOCK_SIZE - stream_held));
+		stream_collect(buf, len, stream_held + n);
+		stream_remain -= n;
+		if (stream_held < MMC_BLOCK_SIZE)
+			return 0;
+
+		stream_held = 0;
+		if (write_raw_chunk_cb((char *)stream_hold, stream_sector, 1))
+			return -1;
+		stream_sector++;
+		return 0;
+	}
 
-	while (total_chunks) {
-		chunk_header = (struct ext4_chunk_header *)img_base;
-		sector_size =
-			(chunk_header->chunk_size * file_header->block_size)
-			>> SECTOR_BITS;
-
-		switch (chunk_header->type) {
-		case EXT4_CHUNK_TYPE_RAW:
-			debug("raw_chunk\n");
-			write_raw_chunk_cb(img_base + EXT4_CHUNK_HEADER_SIZE,
-					   sector_base, sector_size);
-			sector_base += sector_size;
+	cnt = n >> SECTOR_BITS;
+	if (cnt) {
+		if (write_raw_chunk_cb((char *)*buf, stream_sector, cnt))
+			return -1;
+		n = cnt << SECTOR_BITS;
+		stream_sector += cnt;
+		stream_remain -= n;
+		*buf += n;
+		*len -= n;
+		return 0;
+	}
+
+	/* less than a sector left in this piece */
+	stream_collect(buf, len, n);
+	stream_remain -= n;
+
+	return 0;
+}
+
+/*
+ * ext4_img_stream_begin - start writing a compressed ext4 image
+ * @desc: target device
+ * @sector_base: first sector of the target partition
+ */
+int ext4_img_stream_begin(block_dev_desc_t *desc, unsigned int sector_base)
+{
+	img_desc = desc;
+	img_written = 0;
+	stage_cnt = 0;
+	stage_buf = malloc_cache_aligned(STAGE_BUFFER_SIZE);
+	fill_buf = malloc_cache_aligned(FILL_BUFFER_SIZE);
+	if (!stage_buf || !fill_buf) {
+		printf("** Not enough memory for ext4 image write **\n");
+		free(fill_buf);
+		free(stage_buf);
+		fill_buf = NULL;
+		stage_buf = NULL;
+		return -1;
+	}
+	memset(fill_buf, 0, FILL_BUFFER_SIZE);
+	fill_val = 0;
+
+	stream_state = STREAM_FILE_HEADER;
+	stream_err = 0;
+	stream_sector = sector_base;
+	stream_held = 0;
+
+	return 0;
+}
+
+/*
+ * ext4_img_stream_write - feed the next piece of the image
+ * Data after the last chunk is ignored.
+ */
+int ext4_img_stream_write(const char *buf, unsigned long len)
+{
+	const char *piece = buf, *end = buf + len;
+
+	while (len && !stream_err) {
+		switch (stream_state) {
+		case STREAM_FILE_HEADER:
+			if (!stream_collect(&buf, &len, EXT4_FILE_HEADER_SIZE))
+				break;
+			memcpy(&stream_fh, stream_hold, EXT4_FILE_HEADER_SIZE);
+			stream_held = 0;
+			stream_chunks = stream_fh.total_chunks;
+			debug("total chunk = %d\n", stream_chunks);
+			stream_state = stream_chunks ?
+				STREAM_CHUNK_HEADER : STREAM_DONE;
+			break;
+
+		case STREAM_CHUNK_HEADER:
+			if (!stream_collect(&buf, &len,
+					    EXT4_CHUNK_HEADER_SIZE))
+				break;
+			memcpy(&stream_ch, stream_hold, EXT4_CHUNK_HEADER_SIZE);
+			stream_held = 0;
+			stream_chunk_header();
 			break;
 
-		case EXT4_CHUNK_TYPE_FILL:
-			printf("*** fill_chunk ***\n");
-			sector_base += sector_size;
+		case STREAM_RAW:
+			if (stream_raw(&buf, &len))
+				stream_err = -1;
+			else if (!stream_remain)
+				stream_next_chunk();
 			break;
 
-		case EXT4_CHUNK_TYPE_NONE:
-			debug("none chunk\n");
-			sector_base += sector_size;
+		case STREAM_FILL:
+			if (!stream_collect(&buf, &len, sizeof(unsigned int)))
+				break;
+			stream_held = 0;
+			stream_remain -= sizeof(unsigned int);
+			if (write_fill_chunk(*(unsigned int *)stream_hold,
+					     stream_sector,
+					     (stream_ch.chunk_size *
+					      stream_fh.block_size)
+					     >> SECTOR_BITS)) {
+				stream_err = -1;
+				break;
+			}
+			stream_sector += (stream_ch.chunk_size *
+					  stream_fh.block_size) >> SECTOR_BITS;
+			stream_state = STREAM_SKIP;
+			if (!stream_remain)
+				stream_next_chunk();
 			break;
 
-		default:
-			printf("*** unknown chunk type ***\n");
-			sector_base += sector_size;
+		case STREAM_SKIP: {
+			unsigned long n = min((unsigned long)stream_remain,
+					      len);
+
+			buf += n;
+			len -= n;
+			stream_remain -= n;
+			if (!stream_remain)
+				stream_next_chunk();
 			break;
 		}
-		total_chunks--;
-		debug("remain chunks = %d\n", total_chunks);
 
-		img_base += chunk_header->total_size;
-	};
+		case STREAM_DONE:
+			len = 0;
+			break;
+		}
+	}
+
+	/*
+	 * A write may still run out of this piece or the parser's own
+	 * buffers, but not out of an earlier piece: the caller reuses those
+	 */
+	if (img_pending && img_pending != stage_buf &&
+	    img_pending != fill_buf &&
+	    ((const char *)img_pending < piece ||
+	     (const char *)img_pending >= end) && img_write_wait())
+		stream_err = -1;
+
+	return stream_err;
+}
+
+/*
+ * ext4_img_stream_end - flush staged data and release the buffers
+ */
+int ext4_img_stream_end(void)
+{
+	int ret = stream_err;
 
+	if (!ret && stream_state != STREAM_DONE) {
+		printf("** ext4 image is truncated **\n");
+		ret = -1;
+	}
+	if (!ret)
+		ret = stage_flush();
+	if (img_write_wait())
+		ret = -1;
 	debug("write done\n");
-	return 0;
+
+	free(fill_buf);
+	free(stage_buf);
+	fill_buf = NULL;
+	stage_buf = NULL;
+
+	return ret;
+}
+
+int write_compressed_ext4(block_dev_desc_t *desc, char *img_base,
+			  unsigned int sector_base)
+{
+	struct ext4_file_header *file_header;
+	struct ext4_chunk_header *chunk_header;
+	int total_chunks;
+
+	file_header = (struct ext4_file_header *)img_base;
+	total_chunks = file_header->total_chunks;
+
+	if (ext4_img_stream_begin(desc, sector_base))
+		return -1;
+
+	ext4_img_stream_write(img_base, EXT4_FILE_HEADER_SIZE);
+	img_base += EXT4_FILE_HEADER_SIZE;
+
+	while (total_chunks--) {
+		chunk_header = (struct ext4_chunk_header *)img_base;
+		if (ext4_img_stream_write(img_base, chunk_header->total_size))
+			break;
+		img_base += chunk_header->total_size;
+	}
+
+	return ext4_img_stream_end();
 }
 
 int do_compressed_ext4_write(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -227,6 +556,7 @@ int do_compressed_ext4_write(cmd_tbl_t *cmdtp, int flag, int argc,
 	unsigned char *p;
 	char cmd[32];
 	lbaint_t blk, cnt;
+	unsigned long time;
 	int ret, dev;
 
 	if (5 > argc)
@@ -275,9 +605,20 @@ int do_compressed_ext4_write(cmd_tbl_t *cmdtp, int flag, int argc,
 		       (unsigned int)blk, mem_len,
 		       (unsigned int)cnt);
 
-		ret = write_compressed_ext4((char *)p, blk);
+		time = get_timer(0);
+		ret = write_compressed_ext4(desc, (char *)p, blk);
+		time = get_timer(time);
+
+		printf("%lld bytes written in %lu ms", img_written, time);
+		if (time > 0) {
+			puts(" (");
+			print_size(lldiv(img_written, time) * 1000, "/s");
+			puts(")");
+		}
+		puts("\n");
+
 		printf("%s\n", ret ? "Fail" : "Done");
-		return 1;
+		return ret ? 1 : 0;
 	}
 	goto do_write;
 
@@ -291,7 +632,7 @@ do_write:
 	printf("write mmc.%d = 0x%llx(0x%x) ~ 0x%llx(0x%x): ",
 	       dev, dst_addr, (unsigned int)blk, mem_len, (unsigned int)cnt);
 
-	ret = mmc_bwrite(dev, blk, cnt, (void const *)p);
+	ret = desc->block_write(dev, blk, cnt, (void const *)p);
 
 	printf("%s\n", ret ? "Done" : "Fail");
 	return ret;
@@ -0,0 +1,475 @@
+/*
+ * Load the images of a FIT configuration straight from a file system
+ *
+ * Only the device tree structure of the FIT is read into memory, with the
+ * image data left out. The images of the chosen configuration are then
+ * read from the file to their load addresses and hashed as they arrive,
+ * gzip and LZMA images being decompressed on the way; images of other
+ * configurations are never read.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <bootm.h>
+#include <errno.h>
+#include <fs.h>
+#include <hash.h>
+#include <image.h>
+#include <libfdt.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+/* Where the data of an image node is in the file */
+#define FITLOAD_POS_PROP	"data-position"
+#define FITLOAD_SIZE_PROP	"data-size"
+
+#define FITLOAD_WIN_SIZE	SZ_64K	/* for the structure block */
+#define FITLOAD_MAX_HASHES	4
+
+struct fitload {
+	const char *filename;
+	char *win;			/* window over the structure block */
+	loff_t win_pos;
+	loff_t win_len;
+};
+
+struct fitload_hash {
+	struct hash_algo *algo;
+	void *ctx;
+	const uint8_t *value;		/* expected */
+	int value_len;
+};
+
+/* An image being read, for bootm_decomp_stream() */
+struct fitload_stream {
+	struct fitload *fl;
+	loff_t pos;
+	struct fitload_hash *hash;
+	int count;
+};
+
+static int fitload_read(struct fitload *fl, void *buf, loff_t pos, loff_t len)
+{
+	loff_t actread;
+
+	if (fs_read(fl->filename, map_to_sysmem(buf), pos, len, &actread) ||
+	    actread != len)
+		return -EIO;
+
+	return 0;
+}
+
+/* 'len' bytes at 'pos' of the file, through the window */
+static const void *fitload_get(struct fitload *fl, loff_t pos, int len)
+{
+	loff_t actread;
+
+	if (len > FITLOAD_WIN_SIZE)
+		return NULL;
+
+	if (pos < fl->win_pos || pos + len > fl->win_pos + fl->win_len) {
+		if (fs_read(fl->filename, map_to_sysmem(fl->win), pos,
+			    FITLOAD_WIN_SIZE, &actread))
+			return NULL;
+		fl->win_pos = pos;
+		fl->win_len = actread;
+		if (len > actread)
+			return NULL;
+	}
+
+	return fl->win + (pos - fl->win_pos);
+}
+
+/*
+ * Copy the structure of the FIT at the start of the file to 'fit', with
+ * the data of each image replaced by its position and size in the file
+ */
+static int fitload_skeleton(struct fitload *fl, void *fit)
+{
+	struct fdt_header hdr;
+	char *strings;
+	const char *name;
+	const fdt32_t *p;
+	loff_t pos, end;
+	int depth = 0, images = 0;
+	int len, ret;
+
+	ret = fitload_read(fl, &hdr, 0, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (fdt_magic(&hdr) != FDT_MAGIC ||
+	    fdt_version(&hdr) < FDT_FIRST_SUPPORTED_VERSION) {
+		puts("Not a FIT image\n");
+		return -ENOEXEC;
+	}
+
+	strings = malloc(fdt_size_dt_strings(&hdr));
+	if (!strings)
+		return -ENOMEM;
+	ret = fitload_read(fl, strings, fdt_off_dt_strings(&hdr),
+			   fdt_size_dt_strings(&hdr));
+	if (ret)
+		goto out;
+
+	/* Data properties become two cells, a little room is enough */
+	ret = fdt_create(fit, fdt_size_dt_struct(&hdr) +
+			 fdt_size_dt_strings(&hdr) + SZ_4K);
+	if (!ret)
+		ret = fdt_finish_reservemap(fit);
+
+	pos = fdt_off_dt_struct(&hdr);
+	end = pos + fdt_size_dt_struct(&hdr);
+	while (!ret && pos < end) {
+		p = fitload_get(fl, pos, sizeof(*p));
+		if (!p)
+			break;
+
+		switch (fdt32_to_cpu(*p)) {
+		case FDT_BEGIN_NODE:
+			len = min_t(loff_t, end - pos - 4, 256);
+			if (len <= 0)
+				goto bad;
+			name = fitload_get(fl, pos + 4, len);
+			if (!name || strnlen(name, len) == len)
+				goto bad;
+			len = strlen(name);
+			ret = fdt_begin_node(fit, name);
+			depth++;
+			if (depth == 2 && !strcmp(name, FIT_IMAGES_PATH + 1))
+				images = 1;
+			pos += 4 + ALIGN(len + 1, 4);
+			break;
+		case FDT_END_NODE:
+			ret = fdt_end_node(fit);
+			if (depth-- == 2)
+				images = 0;
+			pos += 4;
+			break;
+		case FDT_PROP:
+			p = fitload_get(fl, pos, 12);
+			if (!p)
+				goto bad;
+			/* A length past the end would wrap pos */
+			if (fdt32_to_cpu(p[1]) > end - pos - 12 ||
+			    fdt32_to_cpu(p[2]) >= fdt_size_dt_strings(&hdr))
+				goto bad;
+			len = fdt32_to_cpu(p[1]);
+			name = strings + fdt32_to_cpu(p[2]);
+			pos += 12;
+			if (images && depth == 3 && !strcmp(name, FIT_DATA_PROP)) {
+				ret = fdt_property_u32(fit, FITLOAD_POS_PROP,
+						       pos);
+				if (!ret)
+					ret = fdt_property_u32(fit,
+							FITLOAD_SIZE_PROP, len);
+			} else {
+				p = fitload_get(fl, pos, len);
+				if (!p)
+					goto bad;
+				ret = fdt_property(fit, name, p, len);
+			}
+			pos += ALIGN(len, 4);
+			break;
+		case FDT_NOP:
+			pos += 4;
+			break;
+		case FDT_END:
+			ret = fdt_finish(fit);
+			goto out;
+		default:
+			goto bad;
+		}
+	}
+
+	if (ret) {
+		printf("FIT structure too big: %s\n", fdt_strerror(ret));
+		ret = -ENOSPC;
+		goto out;
+	}
+bad:
+	puts("Bad FIT structure\n");
+	ret = -EINVAL;
+out:
+	free(strings);
+	return ret;
+}
+
+static int fitload_hash_init(const void *fit, int image_noffset,
+			     struct fitload_hash *hash)
+{
+	const char *name;
+	char *algo;
+	int noffset, ignore, count = 0;
+
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		name = fit_get_name(fit, noffset, NULL);
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			return -EINVAL;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (count == FITLOAD_MAX_HASHES ||
+		    hash_progressive_lookup_algo(algo, &hash[count].algo) ||
+		    fit_image_hash_get_value(fit, noffset,
+					     (uint8_t **)&hash[count].value,
+					     &hash[count].value_len) ||
+		    hash[count].algo->hash_init(hash[count].algo,
+						&hash[count].ctx)) {
+			printf("Can't check %s hash of '%s'\n", algo,
+			       fit_get_name(fit, image_noffset, NULL));
+			while (count--)
+				free(hash[count].ctx);
+			return -EINVAL;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+static int fitload_hash_check(struct fitload_hash *hash, int count)
+{
+	uint8_t value[HASH_MAX_DIGEST_SIZE];
+	int i, ret = 0;
+
+	for (i = 0; i < count; i++) {
+		hash[i].algo->hash_finish(hash[i].algo, hash[i].ctx, value,
+					  sizeof(value));
+		/* FIT stores crc32 big-endian */
+		if (!strcmp(hash[i].algo->name, "crc32"))
+			*(u32 *)value = cpu_to_be32(*(u32 *)value);
+		printf("%s", hash[i].algo->name);
+		if (hash[i].value_len != hash[i].algo->digest_size ||
+		    memcmp(value, hash[i].value, hash[i].value_len)) {
+			puts("- ");
+			ret = -EACCES;
+		} else {
+			puts("+ ");
+		}
+	}
+
+	return ret;
+}
+
+static int fitload_stream_read(void *priv, void *buf, ulong len)
+{
+	struct fitload_stream *st = priv;
+	int ret;
+
+	ret = fitload_read(st->fl, buf, st->pos, len);
+	st->pos += len;
+
+	return ret;
+}
+
+/* Runs on a secondary core while the next block is read */
+static void fitload_stream_hash(void *priv, const void *buf, ulong len)
+{
+	struct fitload_stream *st = priv;
+	int i;
+
+	for (i = 0; i < st->count; i++)
+		st->hash[i].algo->hash_update(st->hash[i].algo,
+					      st->hash[i].ctx, buf, len, 0);
+}
+
+static int fitload_image(struct fitload *fl, const void *fit, int noffset,
+			 ulong *freep, ulong *addrp, ulong *sizep)
+{
+	struct fitload_hash hash[FITLOAD_MAX_HASHES];
+	struct fitload_stream st;
+	const fdt32_t *pos, *size;
+	ulong load, load_end, buf;
+	uint8_t comp, type;
+	int has_load, count, ret;
+
+	pos = fdt_getprop(fit, noffset, FITLOAD_POS_PROP, NULL);
+	size = fdt_getprop(fit, noffset, FITLOAD_SIZE_PROP, NULL);
+	if (!pos || !size) {
+		printf("No data in image '%s'\n",
+		       fit_get_name(fit, noffset, NULL));
+		return -ENOENT;
+	}
+	*sizep = fdt32_to_cpu(*size);
+
+	if (fit_image_get_comp(fit, noffset, &comp))
+		comp = IH_COMP_NONE;
+	if (fit_image_get_type(fit, noffset, &type)) {
+		printf("No type in image '%s'\n",
+		       fit_get_name(fit, noffset, NULL));
+		return -EINVAL;
+	}
+	has_load = !fit_image_get_load(fit, noffset, &load);
+	if (!has_load)
+		load = ALIGN(*freep, SZ_4K);
+
+	count = fitload_hash_init(fit, noffset, hash);
+	if (count < 0)
+		return count;
+	st.fl = fl;
+	st.pos = fdt32_to_cpu(*pos);
+	st.hash = hash;
+	st.count = count;
+
+	printf("   Loading '%s' (%s, %lu bytes) to 0x%08lx ... ",
+	       fit_get_name(fit, noffset, NULL), genimg_get_comp_name(comp),
+	       *sizep, load);
+
+	/* Decompressed as it is read, and hashed beside that */
+	ret = bootm_decomp_stream(comp, load, map_sysmem(load, 0), *sizep,
+				  comp == IH_COMP_NONE ? *sizep :
+				  CONFIG_SYS_BOOTM_LEN, fitload_stream_read,
+				  count ? fitload_stream_hash : NULL, &st,
+				  &load_end);
+	buf = load;
+	if (ret == BOOTM_ERR_UNIMPLEMENTED) {
+		/* Other compressions are read to free memory first */
+		buf = ALIGN(*freep, SZ_4K);
+		if (!has_load)
+			load = ALIGN(buf + *sizep, SZ_4K);
+		ret = bootm_decomp_stream(IH_COMP_NONE, buf,
+					  map_sysmem(buf, *sizep), *sizep,
+					  *sizep, fitload_stream_read,
+					  count ? fitload_stream_hash : NULL,
+					  &st, &load_end);
+	}
+
+	if (!ret)
+		ret = fitload_hash_check(hash, count);
+	else
+		while (count--)
+			free(hash[count].ctx);
+	if (ret) {
+		puts(ret == -EACCES ? "Bad Data Hash\n" : "load error\n");
+		return ret;
+	}
+	puts("OK\n");
+
+	if (buf != load) {
+		ret = bootm_decomp_image(comp, load, buf, type,
+					 map_sysmem(load, 0),
+					 map_sysmem(buf, *sizep), *sizep,
+					 CONFIG_SYS_BOOTM_LEN, &load_end);
+		if (ret)
+			return -EIO;
+	}
+	flush_cache(load, load_end - load);
+	*addrp = load;
+	*sizep = load_end - load;
+	if (!has_load)
+		*freep = load_end;
+
+	return 0;
+}
+
+static int do_fitload(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	static const char * const props[] = {
+		FIT_KERNEL_PROP, FIT_RAMDISK_PROP, FIT_FDT_PROP,
+		FIT_LOADABLE_PROP,
+	};
+	struct fitload fl;
+	const char *name, *end;
+	ulong addr, next, load, size;
+	void *fit;
+	char buf[40];
+	int cfg_noffset, noffset, len, i, ret;
+
+	if (argc < 5 || argc > 6)
+		return CMD_RET_USAGE;
+
+	if (IMAGE_ENABLE_VERIFY && gd_fdt_blob() &&
+	    fdt_subnode_offset(gd_fdt_blob(), 0, FIT_SIG_NODENAME) >= 0) {
+		puts("Signed FIT images must be loaded whole\n");
+		return CMD_RET_FAILURE;
+	}
+
+	fl.filename = argv[4];
+	fl.win_pos = 0;
+	fl.win_len = 0;
+	fl.win = malloc(FITLOAD_WIN_SIZE);
+	if (!fl.win)
+		return CMD_RET_FAILURE;
+	if (fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY)) {
+		free(fl.win);
+		return CMD_RET_FAILURE;
+	}
+	/* one probe for all the reads, so the FAT run cache is kept too */
+	fs_hold();
+
+	addr = simple_strtoul(argv[3], NULL, 16);
+	fit = map_sysmem(addr, 0);
+	ret = fitload_skeleton(&fl, fit);
+	if (ret)
+		goto out;
+	next = addr + fdt_totalsize(fit);
+
+	cfg_noffset = fit_conf_get_node(fit, argc > 5 ? argv[5] : NULL);
+	if (cfg_noffset < 0) {
+		puts("Could not find configuration node\n");
+		ret = -ENOENT;
+		goto out;
+	}
+	printf("## Loading FIT configuration '%s' from %s\n",
+	       fit_get_name(fit, cfg_noffset, NULL), fl.filename);
+
+	setenv("fit_kernel", NULL);
+	setenv("fit_ramdisk", "-");
+	setenv("fit_fdt", NULL);
+	for (i = 0; i < ARRAY_SIZE(props); i++) {
+		name = fdt_getprop(fit, cfg_noffset, props[i], &len);
+		if (!name)
+			continue;
+		for (end = name + len; name < end; name += strlen(name) + 1) {
+			noffset = fit_image_get_node(fit, name);
+			if (noffset < 0) {
+				printf("Could not find image '%s'\n", name);
+				ret = noffset;
+				goto out;
+			}
+			ret = fitload_image(&fl, fit, noffset, &next, &load,
+					    &size);
+			if (ret)
+				goto out;
+
+			if (!strcmp(props[i], FIT_KERNEL_PROP)) {
+				setenv_hex("fit_kernel", load);
+			} else if (!strcmp(props[i], FIT_RAMDISK_PROP)) {
+				sprintf(buf, "%lx:%lx", load, size);
+				setenv("fit_ramdisk", buf);
+			} else if (!strcmp(props[i], FIT_FDT_PROP)) {
+				setenv_hex("fit_fdt", load);
+			}
+		}
+	}
+
+out:
+	fs_release();
+	free(fl.win);
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(fitload, 6, 0, do_fitload,
+	"load the images of a FIT configuration from a file system",
+	"<interface> <dev[:part]> <addr> <filename> [config]\n"
+	"    - read the structure of FIT <filename> to <addr>, then each\n"
+	"      image of [config] (default: the default configuration) to\n"
+	"      its load address, checking its hashes as it is read.\n"
+	"      Sets fit_kernel, fit_ramdisk (addr:size, or -) and fit_fdt,\n"
+	"      e.g. for \"booti $fit_kernel $fit_ramdisk $fit_fdt\"."
+);
@@ -849,6 +849,8 @@ ulong ide_write(int device, lbaint_t blknr, lbaint_t blkcnt, const void *buffer)
 	}
 #endif
 
+	blkcache_invalidate(IF_TYPE_IDE, device);
+
 	ide_led(DEVICE_LED(device), 1);	/* LED on       */
 
 	/* Select device
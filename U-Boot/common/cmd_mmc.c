@@ -8,6 +8,7 @@
 #include <common.h>
 #include <command.h>
 #include <console.h>
+#include <div64.h>
 #include <mmc.h>
 
 static int curr_device = -1;
@@ -388,6 +389,58 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
 }
+static int do_mmc_bench(cmd_tbl_t *cmdtp, int flag,
+			int argc, char * const argv[])
+{
+	struct mmc *mmc;
+	u32 blk, cnt, n;
+	ulong start, ms;
+	bool write;
+	void *addr;
+
+	if (argc != 5)
+		return CMD_RET_USAGE;
+
+	if (!strcmp(argv[1], "write"))
+		write = true;
+	else if (!strcmp(argv[1], "read"))
+		write = false;
+	else
+		return CMD_RET_USAGE;
+
+	addr = (void *)simple_strtoul(argv[2], NULL, 16);
+	blk = simple_strtoul(argv[3], NULL, 16);
+	cnt = simple_strtoul(argv[4], NULL, 16);
+
+	mmc = init_mmc_device(curr_device, false);
+	if (!mmc)
+		return CMD_RET_FAILURE;
+
+	if (write && mmc_getwp(mmc) == 1) {
+		printf("Error: card is write protected!\n");
+		return CMD_RET_FAILURE;
+	}
+
+	start = get_timer(0);
+	if (write)
+		n = mmc->block_dev.block_write(curr_device, blk, cnt, addr);
+	else
+		n = mmc->block_dev.block_read(curr_device, blk, cnt, addr);
+	ms = max(get_timer(start), 1UL);
+
+	if (n != cnt) {
+		printf("%d of %d blocks %s: ERROR\n", n, cnt,
+		       write ? "written" : "read");
+		return CMD_RET_FAILURE;
+	}
+
+	printf("%s %d blocks in %lu ms: %llu KiB/s\n",
+	       write ? "wrote" : "read", cnt, ms,
+	       lldiv((u64)cnt * mmc->read_bl_len * 1000 / 1024, ms));
+
+	return CMD_RET_SUCCESS;
+}
+
 static int do_mmc_erase(cmd_tbl_t *cmdtp, int flag,
 			int argc, char * const argv[])
 {
@@ -797,6 +850,7 @@ static cmd_tbl_t cmd_mmc[] = {
 	U_BOOT_CMD_MKENT(read, 4, 1, do_mmc_read, "", ""),
 	U_BOOT_CMD_MKENT(write, 4, 0, do_mmc_write, "", ""),
 	U_BOOT_CMD_MKENT(erase, 3, 0, do_mmc_erase, "", ""),
+	U_BOOT_CMD_MKENT(bench, 5, 0, do_mmc_bench, "", ""),
 	U_BOOT_CMD_MKENT(rescan, 1, 1, do_mmc_rescan, "", ""),
 	U_BOOT_CMD_MKENT(part, 1, 1, do_mmc_part, "", ""),
 	U_BOOT_CMD_MKENT(dev, 3, 0, do_mmc_dev, "", ""),
@@ -847,6 +901,8 @@ U_BOOT_CMD(
 	"mmc read addr blk# cnt\n"
 	"mmc write addr blk# cnt\n"
 	"mmc erase blk# cnt\n"
+	"mmc bench read|write addr blk# cnt - time a transfer,\n"
+	"    a write overwrites the blocks\n"
 	"mmc rescan\n"
 	"mmc part - lists available partition on current mmc device\n"
 	"mmc dev [dev] [part] - show or set current mmc device [partition]\n"
@@ -48,6 +48,22 @@
 
 #define	TCLK_TICK_HZ				(1000000)
 
+/*
+ * Image files are streamed to the device in chunks of this size, so an
+ * image never has to fit in free DRAM. Override with "sdrecchunk",
+ * set it to 0 to load each image whole before writing it.
+ *
+ * Two chunks are used in turn from the load address: one is read while
+ * the other is still being written out with mmc_bwrite_start().
+ */
+#define	UPDATE_SDCARD_CHUNK_SIZE		(32 << 20)
+
+extern int check_compress_ext4(char *img_base, unsigned long long parti_size);
+extern int ext4_img_stream_begin(block_dev_desc_t *desc,
+				 unsigned int sector_base);
+extern int ext4_img_stream_write(const char *buf, unsigned long len);
+extern int ext4_img_stream_end(void);
+
 struct update_sdcard_fs_type {
 	char *name;
 	unsigned int fs_type;
@@ -375,6 +391,38 @@ static int make_mmc_partition(struct update_sdcard_part *fp)
 	return 0;
 }
 
+static int update_sd_get_mmc(int dev, block_dev_desc_t **desc)
+{
+	char cmd[32];
+
+	sprintf(cmd, "mmc dev %d", dev);
+
+	/* set mmc devicee */
+	if (0 > get_device("mmc", simple_itoa(dev), desc)) {
+		if (0 > run_command(cmd, 0)) {
+			printf("MMC get device err\n");
+			return -1;
+		}
+
+		if (0 > run_command("mmc rescan", 0)) {
+			printf("MMC get device err\n");
+			return -1;
+		}
+	}
+
+	if (0 > run_command(cmd, 0)) {
+		printf("MMC set device err\n");
+		return -1;
+	}
+
+	if (0 > get_device("mmc", simple_itoa(dev), desc)) {
+		printf("MMC get device err\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 static int update_sd_img_wirte(struct update_sdcard_part *fp,
 			       unsigned long addr, loff_t len)
 {
@@ -396,33 +444,12 @@ static int update_sd_img_wirte(struct update_sdcard_part *fp,
 	memset(cmd, 0x0, sizeof(cmd));
 
 	if (!strcmp(device, "mmc")) {
-		sprintf(cmd, "mmc dev %d", dev);
 		printf("** mmc.%d partition %s (%s)**\n",
 		       dev, partition_name,
 		       fs_type&UPDATE_SDCARD_FS_EXT4 ? "FS" : "Image");
 
-		/* set mmc devicee */
-		if (0 > get_device("mmc", simple_itoa(dev), &desc)) {
-			if (0 > run_command(cmd, 0)) {
-				printf("MMC get device err\n");
-				return -1;
-			}
-
-			if (0 > run_command("mmc rescan", 0)) {
-				printf("MMC get device err\n");
-				return -1;
-			}
-		}
-
-		if (0 > run_command(cmd, 0)) {
-			printf("MMC set device err\n");
-			return -1;
-		}
-
-		if (0 > get_device("mmc", simple_itoa(dev), &desc)) {
-			printf("MMC get device err\n");
+		if (update_sd_get_mmc(dev, &desc))
 			return -1;
-		}
 
 		memset(cmd, 0x0, sizeof(cmd));
 
@@ -455,13 +482,152 @@ static int update_sd_img_wirte(struct update_sdcard_part *fp,
 	return ret;
 }
 
+/*
+ * Read the image file 'chunk' bytes at a time, into 'addr' and the chunk
+ * after it in turn, and write each chunk to its partition while the next
+ * one is read. Compressed ext4 images go through the streaming
+ * ext4_img_write parser, which leaves its writes running the same way.
+ */
+static int update_sd_img_stream(struct update_sdcard_part *fp,
+				unsigned long addr, char *dev_part, int fs_type,
+				unsigned long chunk)
+{
+	block_dev_desc_t *desc;
+	uint64_t parts[DEV_PART_MAX][2] = { {0, 0}, };
+	uint64_t part_len = ~0ULL;
+	char *ring[2] = { (char *)addr, (char *)addr + chunk };
+	char *buf;
+	loff_t size, pos = 0, len;
+	lbaint_t blk, cnt;
+	unsigned long time;
+	int sparse = 0, num = 0, ret = 0, i = 0;
+
+	if (fs_set_blk_dev("mmc", dev_part, fs_type)) {
+		printf("Block device set err!\n");
+		return -1;
+	}
+
+	if (fs_size(fp->file_name, &size) < 0 || size <= 0)
+		return 0;
+
+	if (strcmp(fp->device, "mmc"))
+		return 0;
+
+	printf("** mmc.%d partition %s (%s)**\n",
+	       fp->dev_no, fp->partition_name,
+	       fp->fs_type&UPDATE_SDCARD_FS_EXT4 ? "FS" : "Image");
+
+	if (update_sd_get_mmc(fp->dev_no, &desc))
+		return -1;
+
+	if (fp->fs_type == UPDATE_SDCARD_FS_2NDBOOT ||
+	    fp->fs_type == UPDATE_SDCARD_FS_BOOT ||
+	    fp->fs_type == UPDATE_SDCARD_FS_ENV) {
+		blk = lldiv(fp->start, 512);
+		if (fp->length)
+			part_len = fp->length;
+	} else if (fp->fs_type & UPDATE_SDCARD_FS_MASK) {
+		if (0 > get_part_table(desc, parts, &num))
+			return -1;
+
+		if (fp->part_num > num || 1 > fp->part_num) {
+			printf("Invalid mmc.%d partition number %d (1 ~ %d)\n",
+			       fp->dev_no, fp->part_num, num);
+			return -1;
+		}
+		blk = lldiv(parts[fp->part_num - 1][0], 512);
+		part_len = parts[fp->part_num - 1][1];
+	} else {
+		return 0;
+	}
+
+	time = get_timer(0);
+
+	while (pos < size) {
+		buf = ring[i];
+		i ^= 1;
+
+		if (fs_set_blk_dev("mmc", dev_part, fs_type)) {
+			ret = -1;
+			break;
+		}
+
+		if (fs_read(fp->file_name, (ulong)buf, pos,
+			    min((loff_t)chunk, size - pos), &len) < 0 ||
+		    len <= 0) {
+			printf("** %s read fail at 0x%llx **\n",
+			       fp->file_name, pos);
+			ret = -1;
+			break;
+		}
+
+		if (!pos && (fp->fs_type & UPDATE_SDCARD_FS_MASK) &&
+		    !check_compress_ext4(buf, part_len)) {
+			if (ext4_img_stream_begin(desc, blk)) {
+				ret = -1;
+				break;
+			}
+			sparse = 1;
+		}
+
+		if (!pos && !sparse && size > part_len) {
+			printf("** %s is 0x%llx bytes, partition %s 0x%llx **\n",
+			       fp->file_name, size, fp->partition_name,
+			       part_len);
+			ret = -1;
+		} else if (sparse) {
+			ret = ext4_img_stream_write(buf, len);
+		} else if (len % 512 && pos + len < size) {
+			printf("** %s short read at 0x%llx **\n",
+			       fp->file_name, pos);
+			ret = -1;
+		} else {
+			/* Runs while the next chunk is read */
+			cnt = DIV_ROUND_UP(len, 512);
+			if (mmc_bwrite_start(fp->dev_no, blk, cnt, buf) != cnt)
+				ret = -1;
+			blk += cnt;
+		}
+		if (ret)
+			break;
+
+		pos += len;
+	}
+
+	if (sparse && ext4_img_stream_end())
+		ret = -1;
+	if (!sparse && mmc_bwrite_wait(fp->dev_no))
+		ret = -1;
+
+	time = get_timer(time);
+
+	printf("%lld bytes flashed in %lu ms", pos, time);
+	if (time > 0) {
+		puts(" (");
+		print_size(lldiv(pos, time) * 1000, "/s");
+		puts(")");
+	}
+	puts("\n");
+
+	printf("Flash : %s - %s\n", fp->file_name, ret ? "FAIL" : "DONE");
+
+	return ret;
+}
+
 static int sdcard_update(struct update_sdcard_part *fp, unsigned long addr,
 			 char *dev, int fs_type)
 {
-	unsigned long time;
+	unsigned long time, chunk;
 	int i = 0, len_read = 0, ret = 0, first_fs = 0;
 	loff_t len;
 
+	chunk = getenv_ulong("sdrecchunk", 16, UPDATE_SDCARD_CHUNK_SIZE);
+	/* Whole sectors, or each chunk would be padded out on the device */
+	if (chunk % 512) {
+		chunk = max(chunk & ~511UL, 512UL);
+		printf("sdrecchunk rounded to 0x%lx\n", chunk);
+	}
+
 	for (i = 0; i < DEV_PART_MAX; i++, fp++) {
 		if (!strcmp(fp->device, ""))
 			break;
@@ -469,6 +635,20 @@ static int sdcard_update(struct update_sdcard_part *fp, unsigned long addr,
 		if (!strcmp(fp->file_name, "dummy"))
 			continue;
 
+		if (chunk) {
+			if (first_fs == 0 &&
+			    (fp->fs_type & UPDATE_SDCARD_FS_MASK)) {
+				first_fs = 1;
+				make_mmc_partition(fp);
+			}
+
+			ret = update_sd_img_stream(fp, addr, dev, fs_type,
+						   chunk);
+			if (ret)
+				return ret;
+			continue;
+		}
+
 		if (fs_set_blk_dev("mmc", dev, fs_type)) {
 			printf("Block device set err!\n");
 			return -1;
@@ -568,4 +748,7 @@ U_BOOT_CMD(
 	"    - part      : partition number\n"
 	"    - addr      : image load address\n"
 	"    - filename  : partition map file\n"
+	"  images are written in 'sdrecchunk' (hex) byte pieces,\n"
+	"  default 0x2000000, read into two buffers from addr in turn;\n"
+	"  0 loads each image whole\n"
 );
@@ -123,6 +123,24 @@ static void fini_mmc_for_env(struct mmc *mmc)
 #endif
 }
 
+static inline int read_env(struct mmc *mmc, unsigned long size,
+			   unsigned long offset, const void *buffer)
+{
+	uint blk_start, blk_cnt, n;
+	int dev = mmc_get_env_dev();
+
+#ifdef CONFIG_SPL_BUILD
+	dev = 0;
+#endif
+
+	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
+	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
+
+	n = mmc->block_dev.block_read(dev, blk_start, blk_cnt, (uchar *)buffer);
+
+	return (n == blk_cnt) ? 0 : -1;
+}
+
 #ifdef CONFIG_CMD_SAVEENV
 static inline int write_env(struct mmc *mmc, unsigned long size,
 			    unsigned long offset, const void *buffer)
@@ -138,7 +156,305 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 
 	return (n == blk_cnt) ? 0 : -1;
 }
+#endif /* CONFIG_CMD_SAVEENV */
+
+#ifdef CONFIG_ENV_MMC_LOG_SIZE
+/*
+ * Log of changes to the environment, in an area of its own. A save that
+ * changes a few variables appends a record with just those, usually a
+ * single block, instead of rewriting all of CONFIG_ENV_SIZE; the
+ * environment itself is only rewritten, and the log started afresh, when
+ * the log is full. The records are replayed over the environment when it
+ * is loaded.
+ *
+ * The log starts with an empty record which names the environment it
+ * applies to by its CRC, and a number that is new each time the log is
+ * started. Records left over from an earlier log do not carry that
+ * number, and a record that was not completely written fails its CRC,
+ * so the log ends before either.
+ */
+#ifdef CONFIG_ENV_AES
+#error CONFIG_ENV_MMC_LOG_SIZE does not support CONFIG_ENV_AES
+#endif
+
+#ifndef CONFIG_ENV_MMC_LOG_OFFSET
+#ifdef CONFIG_ENV_OFFSET_REDUND
+#error CONFIG_ENV_MMC_LOG_OFFSET is needed with CONFIG_ENV_OFFSET_REDUND
+#endif
+#define CONFIG_ENV_MMC_LOG_OFFSET	(CONFIG_ENV_OFFSET + CONFIG_ENV_SIZE)
+#endif
+
+#define ENV_LOG_MAGIC	0x676f4c45	/* "ELog" */
+
+struct env_log_rec {
+	uint32_t magic;
+	uint32_t gen;		/* of the log */
+	uint32_t base_crc;	/* of the environment the log applies to */
+	uint32_t len;		/* of text[] */
+	uint32_t crc;		/* of the above and text[] */
+	/* "name=value\0" sets a variable, "name\0" deletes it */
+	char text[];
+};
+
+static uint32_t env_log_gen;	/* 0 if not known */
+static uint32_t env_log_base;
+static uint32_t env_log_pos;	/* where the next record goes */
+#ifdef CONFIG_CMD_SAVEENV
+static env_t *env_log_saved;	/* as stored, or NULL to rewrite it all */
+#endif
+
+__weak int mmc_get_env_log_addr(struct mmc *mmc, u32 *env_addr)
+{
+	s64 offset = CONFIG_ENV_MMC_LOG_OFFSET;
+
+	if (offset < 0)
+		offset += mmc->capacity;
+
+	*env_addr = offset;
+
+	return 0;
+}
+
+static uint32_t env_log_crc(const struct env_log_rec *rec)
+{
+	uint32_t crc;
+
+	crc = crc32(0, (const void *)rec, offsetof(struct env_log_rec, crc));
+
+	return crc32(crc, (const void *)rec->text, rec->len);
+}
+
+static u32 env_log_rec_size(struct mmc *mmc, u32 len)
+{
+	return ALIGN(sizeof(struct env_log_rec) + len, mmc->write_bl_len);
+}
+
+/* The record at 'pos' of the log, if it belongs to a log for 'base_crc' */
+static struct env_log_rec *env_log_get(char *log, u32 pos, u32 base_crc)
+{
+	struct env_log_rec *rec = (struct env_log_rec *)(log + pos);
+
+	if (pos + sizeof(*rec) > CONFIG_ENV_MMC_LOG_SIZE ||
+	    rec->magic != ENV_LOG_MAGIC || rec->base_crc != base_crc ||
+	    rec->len > CONFIG_ENV_MMC_LOG_SIZE - pos - sizeof(*rec) ||
+	    env_log_crc(rec) != rec->crc)
+		return NULL;
+
+	return rec;
+}
+
+/* Apply the log to the environment just imported from 'ep' */
+static void env_log_replay(struct mmc *mmc, const env_t *ep)
+{
+	struct env_log_rec *rec;
+	char *log;
+	u32 offset, pos;
+	int count = 0;
+
+	env_log_gen = 0;
+	env_log_base = ep->crc;
+#ifdef CONFIG_CMD_SAVEENV
+	free(env_log_saved);
+	env_log_saved = NULL;
+#endif
+
+	log = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_MMC_LOG_SIZE);
+	if (!log)
+		return;
+	if (mmc_get_env_log_addr(mmc, &offset) ||
+	    read_env(mmc, CONFIG_ENV_MMC_LOG_SIZE, offset, log))
+		goto out;
+
+	rec = env_log_get(log, 0, ep->crc);
+	if (!rec || rec->len)
+		goto out;
+	env_log_gen = rec->gen;
+
+	for (pos = env_log_rec_size(mmc, 0);
+	     (rec = env_log_get(log, pos, ep->crc)) && rec->gen == env_log_gen;
+	     pos += env_log_rec_size(mmc, rec->len)) {
+		/* Records hold changes that were already accepted */
+		if (!himport_r(&env_htab, rec->text, rec->len, '\0',
+			       H_NOCLEAR | H_FORCE, 0, 0, NULL)) {
+			puts("*** Warning - environment log import failed\n");
+			goto out;
+		}
+		count++;
+	}
+	env_log_pos = pos;
+	debug("%s: %d records, next at %u\n", __func__, count, pos);
+
+#ifdef CONFIG_CMD_SAVEENV
+	env_log_saved = malloc(sizeof(env_t));
+	if (env_log_saved && env_export(env_log_saved)) {
+		free(env_log_saved);
+		env_log_saved = NULL;
+	}
+#endif
+out:
+	free(log);
+}
+
+#ifdef CONFIG_CMD_SAVEENV
+/* '=' ends a name, and sorts before any character of one */
+static int env_name_cmp(const char *a, const char *b)
+{
+	while (*a == *b && *a != '=') {
+		a++;
+		b++;
+	}
+
+	return (*a == '=' ? 0 : (u8)*a) - (*b == '=' ? 0 : (u8)*b);
+}
+
+/*
+ * Write to 'out' the records that turn the exported environment 'from'
+ * into 'to'; both are sorted by name. Returns the length, or -ENOSPC if
+ * that is over 'room'.
+ */
+static int env_log_diff(const char *from, const char *to, char *out,
+			int room)
+{
+	int len = 0, n, cmp;
+
+	while (*from || *to) {
+		if (!*to)
+			cmp = -1;
+		else if (!*from)
+			cmp = 1;
+		else
+			cmp = env_name_cmp(from, to);
+
+		if (cmp < 0) {
+			n = strchr(from, '=') - from;
+			if (len + n + 1 > room)
+				return -ENOSPC;
+			memcpy(out + len, from, n);
+			out[len + n] = '\0';
+			len += n + 1;
+		} else if (cmp > 0 || strcmp(from, to)) {
+			n = strlen(to) + 1;
+			if (len + n > room)
+				return -ENOSPC;
+			memcpy(out + len, to, n);
+			len += n;
+		}
+
+		if (cmp <= 0)
+			from += strlen(from) + 1;
+		if (cmp >= 0)
+			to += strlen(to) + 1;
+	}
+
+	return len;
+}
+
+/* Append the changes from the stored environment to 'env_new' */
+static int env_log_append(struct mmc *mmc, const env_t *env_new)
+{
+	struct env_log_rec *rec;
+	u32 offset, size;
+	int len, ret = 0;
+
+	if (!env_log_saved)
+		return -ENOENT;
+
+	rec = memalign(ARCH_DMA_MINALIGN, CONFIG_ENV_MMC_LOG_SIZE);
+	if (!rec)
+		return -ENOMEM;
+
+	len = env_log_diff((char *)env_log_saved->data, (char *)env_new->data,
+			   rec->text, (int)CONFIG_ENV_MMC_LOG_SIZE -
+			   (int)(env_log_pos + sizeof(*rec)));
+	if (len > 0) {
+		rec->magic = ENV_LOG_MAGIC;
+		rec->gen = env_log_gen;
+		rec->base_crc = env_log_base;
+		rec->len = len;
+		rec->crc = env_log_crc(rec);
+		size = env_log_rec_size(mmc, len);
+		memset(rec->text + len, 0, size - sizeof(*rec) - len);
+
+		if (mmc_get_env_log_addr(mmc, &offset) ||
+		    write_env(mmc, size, offset + env_log_pos, rec))
+			ret = -EIO;
+		else
+			env_log_pos += size;
+	} else if (len < 0) {
+		ret = len;
+	}
+	if (!ret)
+		memcpy(env_log_saved, env_new, sizeof(env_t));
+
+	free(rec);
+	return ret;
+}
+
+/*
+ * Make the log apply to no environment, before the environment is
+ * rewritten in full: if the rewrite is cut short, the old log must not
+ * be replayed over what was written, which may have the same CRC
+ */
+static int env_log_invalidate(struct mmc *mmc)
+{
+	u32 offset, size = env_log_rec_size(mmc, 0);
+	void *rec;
+	int ret = 0;
+
+	free(env_log_saved);
+	env_log_saved = NULL;
+
+	rec = memalign(ARCH_DMA_MINALIGN, size);
+	if (!rec)
+		return -ENOMEM;
+
+	memset(rec, 0, size);
+	if (mmc_get_env_log_addr(mmc, &offset) ||
+	    write_env(mmc, size, offset, rec))
+		ret = -EIO;
 
+	free(rec);
+	return ret;
+}
+
+/* Start a new log for the environment just written in full */
+static void env_log_reset(struct mmc *mmc, const env_t *env_new)
+{
+	struct env_log_rec *rec;
+	u32 offset, size = env_log_rec_size(mmc, 0);
+
+	free(env_log_saved);
+	env_log_saved = NULL;
+
+	rec = memalign(ARCH_DMA_MINALIGN, size);
+	if (!rec)
+		return;
+
+	/* New for each log, so that no record of an earlier one fits */
+	env_log_gen = env_log_gen ? env_log_gen + 1 : (uint32_t)get_ticks();
+	if (!env_log_gen)
+		env_log_gen = 1;
+	env_log_base = env_new->crc;
+
+	memset(rec, 0, size);
+	rec->magic = ENV_LOG_MAGIC;
+	rec->gen = env_log_gen;
+	rec->base_crc = env_log_base;
+	rec->crc = env_log_crc(rec);
+	if (!mmc_get_env_log_addr(mmc, &offset) &&
+	    !write_env(mmc, size, offset, rec)) {
+		env_log_pos = size;
+		env_log_saved = malloc(sizeof(env_t));
+		if (env_log_saved)
+			memcpy(env_log_saved, env_new, sizeof(env_t));
+	}
+
+	free(rec);
+}
+#endif /* CONFIG_CMD_SAVEENV */
+#endif /* CONFIG_ENV_MMC_LOG_SIZE */
+
+#ifdef CONFIG_CMD_SAVEENV
 #ifdef CONFIG_ENV_OFFSET_REDUND
 static unsigned char env_flags;
 #endif
@@ -162,6 +478,13 @@ int saveenv(void)
 	if (ret)
 		goto fini;
 
+#ifdef CONFIG_ENV_MMC_LOG_SIZE
+	if (!env_log_append(mmc, env_new)) {
+		printf("Writing to MMC(%d) log... done\n", dev);
+		goto fini;
+	}
+#endif
+
 #ifdef CONFIG_ENV_OFFSET_REDUND
 	env_new->flags	= ++env_flags; /* increase the serial */
 
@@ -175,6 +498,13 @@ int saveenv(void)
 	}
 
 	printf("Writing to %sMMC(%d)... ", copy ? "redundant " : "", dev);
+#ifdef CONFIG_ENV_MMC_LOG_SIZE
+	if (env_log_invalidate(mmc)) {
+		puts("failed to clear the log\n");
+		ret = 1;
+		goto fini;
+	}
+#endif
 	if (write_env(mmc, CONFIG_ENV_SIZE, offset, (u_char *)env_new)) {
 		puts("failed\n");
 		ret = 1;
@@ -187,6 +517,9 @@ int saveenv(void)
 #ifdef CONFIG_ENV_OFFSET_REDUND
 	gd->env_valid = gd->env_valid == 2 ? 1 : 2;
 #endif
+#ifdef CONFIG_ENV_MMC_LOG_SIZE
+	env_log_reset(mmc, env_new);
+#endif
 
 fini:
 	fini_mmc_for_env(mmc);
@@ -194,24 +527,6 @@ fini:
 }
 #endif /* CONFIG_CMD_SAVEENV */
 
-static inline int read_env(struct mmc *mmc, unsigned long size,
-			   unsigned long offset, const void *buffer)
-{
-	uint blk_start, blk_cnt, n;
-	int dev = mmc_get_env_dev();
-
-#ifdef CONFIG_SPL_BUILD
-	dev = 0;
-#endif
-
-	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
-	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
-
-	n = mmc->block_dev.block_read(dev, blk_start, blk_cnt, (uchar *)buffer);
-
-	return (n == blk_cnt) ? 0 : -1;
-}
-
 #ifdef CONFIG_ENV_OFFSET_REDUND
 void env_relocate_spec(void)
 {
@@ -290,7 +605,11 @@ void env_relocate_spec(void)
 		ep = tmp_env2;
 
 	env_flags = ep->flags;
-	env_import((char *)ep, 0);
+	if (env_import((char *)ep, 0)) {
+#ifdef CONFIG_ENV_MMC_LOG_SIZE
+		env_log_replay(mmc, ep);
+#endif
+	}
 	ret = 0;
 
 fini:
@@ -334,7 +653,11 @@ void env_relocate_spec(void)
 		goto fini;
 	}
 
-	env_import(buf, 1);
+	if (env_import(buf, 1)) {
+#ifdef CONFIG_ENV_MMC_LOG_SIZE
+		env_log_replay(mmc, (env_t *)buf);
+#endif
+	}
 	ret = 0;
 
 fini:
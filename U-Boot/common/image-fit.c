@@ -15,6 +15,7 @@
 #include <time.h>
 #else
 #include <common.h>
+#include <cpu_work.h>
 #include <errno.h>
 #include <mapmem.h>
 #include <asm/io.h>
@@ -837,7 +838,7 @@ int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
  *     0, on ignore not found
  *     value, on ignore found
  */
-static int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
 {
 	int len;
 	int *value;
@@ -926,9 +927,188 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/*
+ * The hashes of several images are independent, so they are computed
+ * together on all cores before the images are verified one by one; each
+ * result is then used once by fit_image_check_hash(). The biggest images
+ * are started first, so the whole takes about as long as the biggest.
+ */
+struct fit_hash_job {
+	const void *fit;
+	int noffset;			/* of the hash node */
+	const void *data;
+	size_t size;
+	const char *algo;
+	int ret;
+	int value_len;
+	uint8_t value[FIT_MAX_HASH_LEN];
+};
+
+#if !defined(USE_HOSTCC) && defined(CONFIG_CPU_WORK) && \
+	!defined(CONFIG_HW_WATCHDOG) && !defined(CONFIG_WATCHDOG)
+#define FIT_HASH_JOBS	32
+
+static struct fit_hash_job fit_hash_jobs[FIT_HASH_JOBS];
+static int fit_hash_count;
+static int fit_hash_next;
+
+static void fit_hash_work(void *arg)
+{
+	struct fit_hash_job *job;
+	int i;
+
+	while ((i = __atomic_fetch_add(&fit_hash_next, 1, __ATOMIC_RELAXED)) <
+	       fit_hash_count) {
+		job = &fit_hash_jobs[i];
+		job->ret = calculate_hash(job->data, job->size, job->algo,
+					  job->value, &job->value_len);
+	}
+}
+
+static void fit_hash_add_image(const void *fit, int image_noffset)
+{
+	const void *data;
+	size_t size;
+	char *algo;
+	int noffset, ignore, i;
+
+	if (fit_image_get_data(fit, image_noffset, &data, &size))
+		return;
+
+	fdt_for_each_subnode(fit, noffset, image_noffset) {
+		if (strncmp(fit_get_name(fit, noffset, NULL),
+			    FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)) ||
+		    fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		/* Others are reported when the image is verified */
+		if (strcmp(algo, "crc32") && strcmp(algo, "sha1") &&
+		    strcmp(algo, "sha256") && strcmp(algo, "md5"))
+			continue;
+		if (fit_hash_count == FIT_HASH_JOBS)
+			return;
+
+		/* Sorted by size, biggest first */
+		for (i = fit_hash_count; i > 0; i--) {
+			if (fit_hash_jobs[i - 1].size >= size)
+				break;
+			fit_hash_jobs[i] = fit_hash_jobs[i - 1];
+		}
+		fit_hash_jobs[i].fit = fit;
+		fit_hash_jobs[i].noffset = noffset;
+		fit_hash_jobs[i].data = data;
+		fit_hash_jobs[i].size = size;
+		fit_hash_jobs[i].algo = algo;
+		fit_hash_count++;
+	}
+}
+
+/*
+ * Hash the images of a configuration, or all images for a negative
+ * conf_noffset, ahead of their verification
+ */
+static void fit_hash_prepare(const void *fit, int conf_noffset)
+{
+	static const char * const props[] = {
+		FIT_KERNEL_PROP, FIT_RAMDISK_PROP, FIT_FDT_PROP,
+		FIT_LOADABLE_PROP,
+	};
+	const char *name, *end;
+	int noffset, len, i, n;
+
+	fit_hash_count = 0;
+	fit_hash_next = 0;
+
+	if (conf_noffset < 0) {
+		noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
+		if (noffset < 0)
+			return;
+		fdt_for_each_subnode(fit, i, noffset)
+			fit_hash_add_image(fit, i);
+	} else {
+		for (i = 0; i < ARRAY_SIZE(props); i++) {
+			name = fdt_getprop(fit, conf_noffset, props[i], &len);
+			if (!name)
+				continue;
+			for (end = name + len; name < end;
+			     name += strlen(name) + 1) {
+				noffset = fit_image_get_node(fit, name);
+				if (noffset >= 0)
+					fit_hash_add_image(fit, noffset);
+			}
+		}
+	}
+
+	/* Not worth waking the other cores for */
+	if (fit_hash_count < 2) {
+		fit_hash_count = 0;
+		return;
+	}
+
+	n = cpu_work_run(fit_hash_work, NULL);
+	if (n < 0) {
+		/* Some hashes may be half done: verify them all here */
+		printf("FIT: hashing on other cores failed (%d)\n", n);
+		fit_hash_count = 0;
+		return;
+	}
+	debug("%s: %d hashes on %d cores\n", __func__, fit_hash_count, n);
+}
+
+/*
+ * Results are matched by address only, so they must not outlive the
+ * verification they were computed for: the same place may hold other data
+ * later.
+ */
+void fit_hash_clear(void)
+{
+	fit_hash_count = 0;
+}
+
+static struct fit_hash_job *fit_hash_lookup(const void *fit, int noffset,
+					    const void *data, size_t size)
+{
+	struct fit_hash_job *job;
+	int i;
+
+	for (i = 0; i < fit_hash_count; i++) {
+		job = &fit_hash_jobs[i];
+		if (job->fit == fit && job->noffset == noffset &&
+		    job->data == data && job->size == size) {
+			/* Used once: the data may change after loading */
+			job->fit = NULL;
+			return job;
+		}
+	}
+
+	return NULL;
+}
+#else
+static inline void fit_hash_prepare(const void *fit, int conf_noffset)
+{
+}
+
+void fit_hash_clear(void)
+{
+}
+
+static inline struct fit_hash_job *fit_hash_lookup(const void *fit,
+						   int noffset,
+						   const void *data,
+						   size_t size)
+{
+	return NULL;
+}
+#endif
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
+	struct fit_hash_job *job;
 	uint8_t value[FIT_MAX_HASH_LEN];
 	int value_len;
 	char *algo;
@@ -958,7 +1138,15 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	job = fit_hash_lookup(fit, noffset, data, size);
+	if (job) {
+		if (job->ret) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
+		value_len = job->value_len;
+		memcpy(value, job->value, value_len);
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1082,6 +1270,7 @@ int fit_all_image_verify(const void *fit)
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
+	fit_hash_prepare(fit, -1);
 	for (ndepth = 0, count = 0,
 	     noffset = fdt_next_node(fit, images_noffset, &ndepth);
 			(noffset >= 0) && (ndepth > 0);
@@ -1094,11 +1283,14 @@ int fit_all_image_verify(const void *fit)
 			printf("   Hash(es) for Image %u (%s): ", count++,
 			       fit_get_name(fit, noffset, NULL));
 
-			if (!fit_image_verify(fit, noffset))
+			if (!fit_image_verify(fit, noffset)) {
+				fit_hash_clear();
 				return 0;
+			}
 			printf("\n");
 		}
 	}
+	fit_hash_clear();
 	return 1;
 }
 
@@ -1611,6 +1803,8 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		if (image_type == IH_TYPE_KERNEL) {
 			/* Remember (and possibly verify) this config */
 			images->fit_uname_cfg = fit_uname_config;
+			if (images->verify)
+				fit_hash_prepare(fit, cfg_noffset);
 			if (IMAGE_ENABLE_VERIFY && images->verify) {
 				puts("   Verifying Hash Integrity ... ");
 				if (fit_config_verify(fit, cfg_noffset)) {
@@ -223,6 +223,10 @@ static int usb_stor_probe_device(struct usb_device *dev)
 
 void usb_stor_reset(void)
 {
+	int i;
+
+	for (i = 0; i < usb_max_devs; i++)
+		blkcache_invalidate(IF_TYPE_USB, i);
 	usb_max_devs = 0;
 }
 
@@ -1112,6 +1116,7 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		return 0;
 
 	device &= 0xff;
+	blkcache_invalidate(IF_TYPE_USB, device);
 	/* Setup  device */
 	debug("\nusb_write: dev %d\n", device);
 	dev = usb_dev_desc[device].priv;
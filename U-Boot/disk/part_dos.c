@@ -90,7 +90,7 @@ int test_part_dos (block_dev_desc_t *dev_desc)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
-	if (dev_desc->block_read(dev_desc->dev, 0, 1, (ulong *) buffer) != 1)
+	if (blk_dread(dev_desc, 0, 1, (ulong *) buffer) != 1)
 		return -1;
 
 	if (test_block_type(buffer) != DOS_MBR)
@@ -109,7 +109,7 @@ static void print_partition_extended(block_dev_desc_t *dev_desc,
 	dos_partition_t *pt;
 	int i;
 
-	if (dev_desc->block_read(dev_desc->dev, ext_part_sector, 1, (ulong *) buffer) != 1) {
+	if (blk_dread(dev_desc, ext_part_sector, 1, (ulong *) buffer) != 1) {
 		printf ("** Can't read partition table on %d:%d **\n",
 			dev_desc->dev, ext_part_sector);
 		return;
@@ -173,7 +173,7 @@ static int get_partition_info_extended (block_dev_desc_t *dev_desc, int ext_part
 	int i;
 	int dos_type;
 
-	if (dev_desc->block_read (dev_desc->dev, ext_part_sector, 1, (ulong *) buffer) != 1) {
+	if (blk_dread(dev_desc, ext_part_sector, 1, (ulong *) buffer) != 1) {
 		printf ("** Can't read partition table on %d:%d **\n",
 			dev_desc->dev, ext_part_sector);
 		return -1;
@@ -300,7 +300,7 @@ static int get_part_table_extended(block_dev_desc_t *desc,
 	debug("--- LBA S= 0x%llx : 0x%llx ---\n",
 	      (uint64_t)lba_start*desc->blksz, (uint64_t)relative*desc->blksz);
 
-	if (0 > desc->block_read(desc->dev, lba_start, 1, (void *)buffer)) {
+	if (0 > blk_dread(desc, lba_start, 1, (void *)buffer)) {
 		printf("** Error read mmc.%d partition info **\n", desc->dev);
 		return -1;
 	}
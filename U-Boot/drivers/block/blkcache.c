@@ -0,0 +1,164 @@
+/*
+ * Cache of recently read blocks, for the small reads of partition tables,
+ * file system metadata and directories
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <linux/list.h>
+
+struct block_cache_node {
+	struct list_head lh;	/* most recently used first */
+	int if_type;
+	int dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	unsigned long blksz;
+	char *cache;
+};
+
+static LIST_HEAD(block_cache);
+
+static struct block_cache_stats _stats = {
+	.max_blocks_per_entry = 8,
+	.max_entries = 32,
+};
+
+static struct block_cache_node *cache_find(int if_type, int dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   unsigned long blksz)
+{
+	struct block_cache_node *node;
+
+	list_for_each_entry(node, &block_cache, lh) {
+		if (node->if_type == if_type && node->dev == dev &&
+		    node->blksz == blksz && node->start <= start &&
+		    node->start + node->blkcnt >= start + blkcnt) {
+			if (block_cache.next != &node->lh)
+				list_move(&node->lh, &block_cache);
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+static void cache_free(struct block_cache_node *node)
+{
+	list_del(&node->lh);
+	free(node->cache);
+	free(node);
+	_stats.entries--;
+}
+
+/* A node for 'bytes' of data: a new one, or the least recently used */
+static struct block_cache_node *cache_get(size_t bytes)
+{
+	struct block_cache_node *node;
+
+	if (_stats.entries >= _stats.max_entries) {
+		node = list_entry(block_cache.prev, struct block_cache_node,
+				  lh);
+		list_del(&node->lh);
+		_stats.entries--;
+		if (node->blkcnt * node->blksz == bytes)
+			return node;
+		free(node->cache);
+	} else {
+		node = malloc(sizeof(*node));
+		if (!node)
+			return NULL;
+	}
+
+	node->cache = memalign(ARCH_DMA_MINALIGN, bytes);
+	if (!node->cache) {
+		free(node);
+		return NULL;
+	}
+
+	return node;
+}
+
+ulong blk_dread(block_dev_desc_t *dev_desc, lbaint_t start, lbaint_t blkcnt,
+		void *buffer)
+{
+	struct block_cache_node *node;
+	unsigned long blksz = dev_desc->blksz;
+	lbaint_t count;
+
+	if (!blkcnt || blkcnt > _stats.max_blocks_per_entry ||
+	    !_stats.max_entries)
+		return dev_desc->block_read(dev_desc->dev, start, blkcnt,
+					    buffer);
+
+	node = cache_find(dev_desc->if_type, dev_desc->dev, start, blkcnt,
+			  blksz);
+	if (node) {
+		memcpy(buffer, node->cache + (start - node->start) * blksz,
+		       blkcnt * blksz);
+		_stats.hits++;
+		return blkcnt;
+	}
+	_stats.misses++;
+
+	/* Read ahead to a whole entry, within the device */
+	count = _stats.max_blocks_per_entry;
+	if (dev_desc->lba && start + count > dev_desc->lba)
+		count = max(dev_desc->lba - start, blkcnt);
+
+	node = cache_get(count * blksz);
+	if (!node)
+		return dev_desc->block_read(dev_desc->dev, start, blkcnt,
+					    buffer);
+
+	if (dev_desc->block_read(dev_desc->dev, start, count,
+				 node->cache) != count) {
+		free(node->cache);
+		free(node);
+		return dev_desc->block_read(dev_desc->dev, start, blkcnt,
+					    buffer);
+	}
+
+	node->if_type = dev_desc->if_type;
+	node->dev = dev_desc->dev;
+	node->start = start;
+	node->blkcnt = count;
+	node->blksz = blksz;
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+
+	memcpy(buffer, node->cache, blkcnt * blksz);
+
+	return blkcnt;
+}
+
+void blkcache_invalidate(int if_type, int dev)
+{
+	struct block_cache_node *node, *tmp;
+
+	list_for_each_entry_safe(node, tmp, &block_cache, lh) {
+		if (node->if_type == if_type && node->dev == dev)
+			cache_free(node);
+	}
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries)
+{
+	struct block_cache_node *node, *tmp;
+
+	list_for_each_entry_safe(node, tmp, &block_cache, lh)
+		cache_free(node);
+
+	_stats.max_blocks_per_entry = blocks;
+	_stats.max_entries = entries;
+	_stats.hits = 0;
+	_stats.misses = 0;
+}
+
+void blkcache_stats(struct block_cache_stats *stats)
+{
+	memcpy(stats, &_stats, sizeof(*stats));
+}
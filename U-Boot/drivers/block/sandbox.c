@@ -46,6 +46,8 @@ static unsigned long host_block_write(int dev, unsigned long start,
 				      lbaint_t blkcnt, const void *buffer)
 {
 	struct host_block_dev *host_dev = find_host_device(dev);
+
+	blkcache_invalidate(IF_TYPE_HOST, dev);
 	if (os_lseek(host_dev->fd,
 		     start * host_dev->blk_dev.blksz,
 		     OS_SEEK_SET) == -1) {
@@ -65,6 +67,7 @@ int host_dev_bind(int dev, char *filename)
 
 	if (!host_dev)
 		return -1;
+	blkcache_invalidate(IF_TYPE_HOST, dev);
 	if (host_dev->blk_dev.priv) {
 		os_close(host_dev->fd);
 		host_dev->blk_dev.priv = NULL;
@@ -8,6 +8,7 @@
  */
 
 #include <common.h>
+#include <cpu_work.h>
 #include <errno.h>
 #include <malloc.h>
 #include <mmc.h>
@@ -123,7 +124,7 @@ static char *dfu_get_hash_algo(void)
 	if (!s)
 		return NULL;
 
-	if (!strcmp(s, "crc32")) {
+	if (!strcmp(s, "crc32") || !strcmp(s, "sha256")) {
 		debug("%s: DFU hash method: %s\n", __func__, s);
 		return s;
 	}
@@ -132,6 +133,82 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
+static int dfu_hash_init(struct dfu_entity *dfu)
+{
+	if (!dfu_hash_algo || dfu->hash_ctx)
+		return 0;
+
+	return dfu_hash_algo->hash_init(dfu_hash_algo, &dfu->hash_ctx);
+}
+
+static struct {
+	void *ctx;
+	const void *buf;
+	unsigned int size;
+} dfu_hash_job;
+
+static void dfu_hash_update(void *arg)
+{
+	dfu_hash_algo->hash_update(dfu_hash_algo, dfu_hash_job.ctx,
+				   dfu_hash_job.buf, dfu_hash_job.size, 0);
+}
+
+/*
+ * Start hashing 'size' bytes at 'buf' on another core; the caller writes
+ * them to the medium meanwhile and then waits with dfu_hash_wait()
+ */
+static void dfu_hash_start(struct dfu_entity *dfu, const void *buf,
+			   long size)
+{
+	if (!dfu->hash_ctx)
+		return;
+
+	dfu_hash_job.ctx = dfu->hash_ctx;
+	dfu_hash_job.buf = buf;
+	dfu_hash_job.size = size;
+	cpu_work_start(dfu_hash_update, NULL);
+}
+
+static void dfu_hash_wait(struct dfu_entity *dfu)
+{
+	if (!dfu->hash_ctx || !cpu_work_finish())
+		return;
+
+	/*
+	 * The core hashing the buffer hung: the hash is lost, and its
+	 * context is left to that core rather than freed under it
+	 */
+	error("DFU %s: hash not done, dropped\n", dfu->name);
+	dfu->hash_ctx = NULL;
+}
+
+/* Print the hash of the transfer, or only show it with 'verbose' unset */
+static void dfu_hash_finish(struct dfu_entity *dfu, bool verbose)
+{
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	char str[HASH_MAX_DIGEST_SIZE * 2 + 1];
+	int i;
+
+	if (!dfu->hash_ctx)
+		return;
+
+	dfu_hash_algo->hash_finish(dfu_hash_algo, dfu->hash_ctx, digest,
+				   sizeof(digest));
+	dfu->hash_ctx = NULL;
+
+	if (dfu_hash_algo->digest_size == 4)
+		sprintf(str, "0x%08x", *(u32 *)digest);
+	else
+		for (i = 0; i < dfu_hash_algo->digest_size; i++)
+			sprintf(str + 2 * i, "%02x", digest[i]);
+
+	if (verbose)
+		printf("\nDFU complete %s: %s\n", dfu_hash_algo->name, str);
+	else
+		debug("%s: %s %s: %s\n", __func__, dfu->name,
+		      dfu_hash_algo->name, str);
+}
+
 static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 {
 	long w_size;
@@ -142,11 +219,9 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 	if (w_size == 0)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
-
+	dfu_hash_start(dfu, dfu->i_buf_start, w_size);
 	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
+	dfu_hash_wait(dfu);
 	if (ret)
 		debug("%s: Write error!\n", __func__);
 
@@ -164,7 +239,8 @@ static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
-	dfu->crc = 0;
+	free(dfu->hash_ctx);
+	dfu->hash_ctx = NULL;
 	dfu->offset = 0;
 	dfu->i_blk_seq_num = 0;
 	dfu->i_buf_start = dfu_buf;
@@ -184,15 +260,71 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	if (dfu->flush_medium)
 		ret = dfu->flush_medium(dfu);
 
-	if (dfu_hash_algo)
-		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
-		       dfu->crc);
+	dfu_hash_finish(dfu, true);
 
 	dfu_write_transaction_cleanup(dfu);
 
 	return ret;
 }
 
+static int dfu_write_init(struct dfu_entity *dfu)
+{
+	if (dfu->inited)
+		return 0;
+
+	/* initial state */
+	dfu->offset = 0;
+	dfu->bad_skip = 0;
+	dfu->i_blk_seq_num = 0;
+	dfu->i_buf_start = dfu_get_buf(dfu);
+	if (dfu->i_buf_start == NULL)
+		return -ENOMEM;
+	dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+	if (dfu_hash_init(dfu))
+		return -ENOMEM;
+
+	dfu->inited = 1;
+
+	return 0;
+}
+
+/*
+ * Write 'size' bytes at 'buf' to the medium at the current offset, without
+ * staging them in the DFU buffer; for callers receiving into buffers of
+ * their own. Finish the transfer with dfu_flush().
+ */
+int dfu_write_direct(struct dfu_entity *dfu, void *buf, long size)
+{
+	long w_size = size;
+	int ret;
+
+	ret = dfu_write_init(dfu);
+	if (ret)
+		return ret;
+
+	if (dfu->i_buf != dfu->i_buf_start) {
+		ret = dfu_write_buffer_drain(dfu);
+		if (ret)
+			goto err;
+	}
+
+	dfu_hash_start(dfu, buf, size);
+	ret = dfu->write_medium(dfu, dfu->offset, buf, &w_size);
+	dfu_hash_wait(dfu);
+	if (ret)
+		goto err;
+
+	dfu->offset += w_size;
+
+	return 0;
+
+err:
+	debug("%s: Write error!\n", __func__);
+	dfu_write_transaction_cleanup(dfu);
+	return ret;
+}
+
 int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
 	int ret;
@@ -201,20 +333,9 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	      __func__, dfu->name, buf, size, blk_seq_num, dfu->offset,
 	      (unsigned long)(dfu->i_buf - dfu->i_buf_start));
 
-	if (!dfu->inited) {
-		/* initial state */
-		dfu->crc = 0;
-		dfu->offset = 0;
-		dfu->bad_skip = 0;
-		dfu->i_blk_seq_num = 0;
-		dfu->i_buf_start = dfu_get_buf(dfu);
-		if (dfu->i_buf_start == NULL)
-			return -ENOMEM;
-		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
-		dfu->i_buf = dfu->i_buf_start;
-
-		dfu->inited = 1;
-	}
+	ret = dfu_write_init(dfu);
+	if (ret)
+		return ret;
 
 	if (dfu->i_blk_seq_num != blk_seq_num) {
 		printf("%s: Wrong sequence number! [%d] [%d]\n",
@@ -283,9 +404,9 @@ static int dfu_read_buffer_fill(struct dfu_entity *dfu, void *buf, int size)
 		/* consume */
 		if (chunk > 0) {
 			memcpy(buf, dfu->i_buf, chunk);
-			if (dfu_hash_algo)
+			if (dfu->hash_ctx)
 				dfu_hash_algo->hash_update(dfu_hash_algo,
-							   &dfu->crc, buf,
+							   dfu->hash_ctx, buf,
 							   chunk, 0);
 
 			dfu->i_buf += chunk;
@@ -342,11 +463,12 @@ int dfu_read(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		debug("%s: %s %ld [B]\n", __func__, dfu->name, dfu->r_left);
 
 		dfu->i_blk_seq_num = 0;
-		dfu->crc = 0;
 		dfu->offset = 0;
 		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
 		dfu->i_buf = dfu->i_buf_start;
 		dfu->b_left = 0;
+		if (dfu_hash_init(dfu))
+			return -ENOMEM;
 
 		dfu->bad_skip = 0;
 
@@ -368,13 +490,10 @@ int dfu_read(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	}
 
 	if (ret < size) {
-		if (dfu_hash_algo)
-			debug("%s: %s %s: 0x%x\n", __func__, dfu->name,
-			      dfu_hash_algo->name, dfu->crc);
+		dfu_hash_finish(dfu, false);
 		puts("\nUPLOAD ... done\nCtrl+C to exit ...\n");
 
 		dfu->i_blk_seq_num = 0;
-		dfu->crc = 0;
 		dfu->offset = 0;
 		dfu->i_buf_start = dfu_buf;
 		dfu->i_buf_end = dfu_buf;
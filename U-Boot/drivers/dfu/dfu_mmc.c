@@ -15,6 +15,8 @@
 #include <ext4fs.h>
 #include <fat.h>
 #include <mmc.h>
+#include <image-sparse.h>
+#include <linux/sizes.h>
 
 static unsigned char *dfu_file_buf;
 static long dfu_file_buf_len;
@@ -104,6 +106,278 @@ static int mmc_block_op(enum dfu_op op, struct dfu_entity *dfu,
 	return 0;
 }
 
+/*
+ * An Android sparse image sent to a raw area is written out as it
+ * arrives: the headers are parsed across calls, raw chunks are written
+ * straight from the caller's buffer, fill chunks from a buffer of the
+ * pattern, and don't care chunks are skipped over on the medium.
+ */
+enum {
+	SPARSE_NONE,
+	SPARSE_FILE_HDR,
+	SPARSE_CHUNK_HDR,
+	SPARSE_RAW,
+	SPARSE_FILL,
+	SPARSE_CRC32,
+	SPARSE_DONE,
+};
+
+#define SPARSE_FILL_SIZE	min_t(long, SZ_1M, CONFIG_SYS_DFU_MAX_FILE_SIZE)
+
+static struct {
+	int state;
+	sparse_header_t hdr;
+	chunk_header_t chunk;
+	u32 fill;
+	u32 got;		/* bytes of a header or the fill word so far */
+	u32 skip;		/* header bytes past the fields we know */
+	u64 left;		/* bytes of raw data or fill still to come */
+	u32 chunks;		/* chunks still to come */
+	u64 out;		/* offset in the area of the next output byte */
+	u32 part_len;		/* raw data held back in part_blk */
+	u8 part_blk[512] __aligned(ARCH_DMA_MINALIGN);
+} dfu_sparse;
+
+static long sparse_collect(void *dst, u32 size, const u8 *buf, long len)
+{
+	long n = min((long)(size - dfu_sparse.got), len);
+
+	memcpy(dst + dfu_sparse.got, buf, n);
+	dfu_sparse.got += n;
+
+	return n;
+}
+
+static int sparse_write(struct dfu_entity *dfu, void *buf, long len)
+{
+	int ret;
+
+	ret = mmc_block_op(DFU_OP_WRITE, dfu, dfu_sparse.out, buf, &len);
+	dfu_sparse.out += len;
+
+	return ret;
+}
+
+static int sparse_write_fill(struct dfu_entity *dfu)
+{
+	u32 *fill = (u32 *)dfu_file_buf;
+	long n;
+	int i, ret;
+
+	n = min((u64)SPARSE_FILL_SIZE, dfu_sparse.left);
+	for (i = 0; i < n / sizeof(u32); i++)
+		fill[i] = dfu_sparse.fill;
+
+	while (dfu_sparse.left) {
+		n = min((u64)SPARSE_FILL_SIZE, dfu_sparse.left);
+		ret = sparse_write(dfu, fill, n);
+		if (ret)
+			return ret;
+		dfu_sparse.left -= n;
+	}
+
+	return 0;
+}
+
+/* Write whole blocks of raw chunk data, keeping back a partial one */
+static long sparse_write_raw(struct dfu_entity *dfu, u8 *buf, long len)
+{
+	u32 blksz = dfu->data.mmc.lba_blk_size;
+	long n, done = 0;
+	int ret;
+
+	len = min((u64)len, dfu_sparse.left);
+	if (dfu_sparse.part_len) {
+		n = min((long)(blksz - dfu_sparse.part_len), len);
+		memcpy(dfu_sparse.part_blk + dfu_sparse.part_len, buf, n);
+		dfu_sparse.part_len += n;
+		done = n;
+		if (dfu_sparse.part_len < blksz)
+			goto out;
+		ret = sparse_write(dfu, dfu_sparse.part_blk, blksz);
+		if (ret)
+			return ret;
+		dfu_sparse.part_len = 0;
+	}
+
+	n = rounddown(len - done, blksz);
+	if (n) {
+		ret = sparse_write(dfu, buf + done, n);
+		if (ret)
+			return ret;
+		done += n;
+	}
+
+	n = len - done;
+	memcpy(dfu_sparse.part_blk, buf + done, n);
+	dfu_sparse.part_len = n;
+	done = len;
+out:
+	dfu_sparse.left -= done;
+
+	return done;
+}
+
+static void sparse_next_chunk(void)
+{
+	dfu_sparse.got = 0;
+	dfu_sparse.state = dfu_sparse.chunks ? SPARSE_CHUNK_HDR : SPARSE_DONE;
+}
+
+static int sparse_check_header(struct dfu_entity *dfu)
+{
+	sparse_header_t *hdr = &dfu_sparse.hdr;
+	u32 blksz = le32_to_cpu(hdr->blk_sz);
+
+	if (le16_to_cpu(hdr->file_hdr_sz) < sizeof(sparse_header_t) ||
+	    le16_to_cpu(hdr->chunk_hdr_sz) < sizeof(chunk_header_t) ||
+	    !blksz || blksz % dfu->data.mmc.lba_blk_size ||
+	    dfu->data.mmc.lba_blk_size > sizeof(dfu_sparse.part_blk)) {
+		error("Unsupported sparse image");
+		return -EINVAL;
+	}
+
+	debug("%s: %u chunks, %u blocks of %u bytes\n", __func__,
+	      le32_to_cpu(hdr->total_chunks), le32_to_cpu(hdr->total_blks),
+	      blksz);
+
+	dfu_sparse.chunks = le32_to_cpu(hdr->total_chunks);
+	dfu_sparse.skip = le16_to_cpu(hdr->file_hdr_sz) - sizeof(*hdr);
+	sparse_next_chunk();
+
+	return 0;
+}
+
+static int sparse_start_chunk(void)
+{
+	chunk_header_t *chunk = &dfu_sparse.chunk;
+	u16 type = le16_to_cpu(chunk->chunk_type);
+	u64 out = (u64)le32_to_cpu(chunk->chunk_sz) *
+		  le32_to_cpu(dfu_sparse.hdr.blk_sz);
+	u32 hdr_sz = le16_to_cpu(dfu_sparse.hdr.chunk_hdr_sz);
+	u32 data = le32_to_cpu(chunk->total_sz) - hdr_sz;
+
+	if (le32_to_cpu(chunk->total_sz) < hdr_sz)
+		goto bad;
+
+	dfu_sparse.chunks--;
+	dfu_sparse.skip = hdr_sz - sizeof(*chunk);
+	dfu_sparse.got = 0;
+	dfu_sparse.left = out;
+
+	switch (type) {
+	case CHUNK_TYPE_RAW:
+		if (data != out)
+			goto bad;
+		dfu_sparse.state = SPARSE_RAW;
+		break;
+	case CHUNK_TYPE_FILL:
+		if (data != sizeof(u32))
+			goto bad;
+		dfu_sparse.state = SPARSE_FILL;
+		break;
+	case CHUNK_TYPE_DONT_CARE:
+		if (data)
+			goto bad;
+		dfu_sparse.out += out;
+		sparse_next_chunk();
+		break;
+	case CHUNK_TYPE_CRC32:
+		if (data != sizeof(u32))
+			goto bad;
+		dfu_sparse.state = SPARSE_CRC32;
+		break;
+	default:
+		goto bad;
+	}
+
+	return 0;
+
+bad:
+	error("Bad sparse chunk: type 0x%x size %u", type,
+	      le32_to_cpu(chunk->total_sz));
+	return -EINVAL;
+}
+
+static int mmc_sparse_write(struct dfu_entity *dfu, u8 *buf, long len)
+{
+	long n;
+	int ret = 0;
+
+	while (len) {
+		if (dfu_sparse.skip) {
+			n = min((long)dfu_sparse.skip, len);
+			dfu_sparse.skip -= n;
+			buf += n;
+			len -= n;
+			continue;
+		}
+
+		switch (dfu_sparse.state) {
+		case SPARSE_FILE_HDR:
+			n = sparse_collect(&dfu_sparse.hdr,
+					   sizeof(dfu_sparse.hdr), buf, len);
+			if (dfu_sparse.got == sizeof(dfu_sparse.hdr))
+				ret = sparse_check_header(dfu);
+			break;
+		case SPARSE_CHUNK_HDR:
+			n = sparse_collect(&dfu_sparse.chunk,
+					   sizeof(dfu_sparse.chunk), buf, len);
+			if (dfu_sparse.got == sizeof(dfu_sparse.chunk))
+				ret = sparse_start_chunk();
+			break;
+		case SPARSE_RAW:
+			n = sparse_write_raw(dfu, buf, len);
+			if (n < 0)
+				ret = n;
+			else if (!dfu_sparse.left)
+				sparse_next_chunk();
+			break;
+		case SPARSE_FILL:
+			n = sparse_collect(&dfu_sparse.fill,
+					   sizeof(dfu_sparse.fill), buf, len);
+			if (dfu_sparse.got == sizeof(dfu_sparse.fill)) {
+				ret = sparse_write_fill(dfu);
+				sparse_next_chunk();
+			}
+			break;
+		case SPARSE_CRC32:
+			n = sparse_collect(&dfu_sparse.fill,
+					   sizeof(dfu_sparse.fill), buf, len);
+			if (dfu_sparse.got == sizeof(dfu_sparse.fill))
+				sparse_next_chunk();
+			break;
+		default:
+			/* Padding after the last chunk */
+			n = len;
+			break;
+		}
+		if (ret) {
+			dfu_sparse.state = SPARSE_NONE;
+			return ret;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int mmc_raw_write(struct dfu_entity *dfu, u64 offset, void *buf,
+			 long *len)
+{
+	if (!offset) {
+		memset(&dfu_sparse, 0, offsetof(typeof(dfu_sparse), part_blk));
+		if (*len >= sizeof(sparse_header_t) && is_sparse_image(buf))
+			dfu_sparse.state = SPARSE_FILE_HDR;
+	}
+
+	if (dfu_sparse.state != SPARSE_NONE)
+		return mmc_sparse_write(dfu, buf, *len);
+
+	return mmc_block_op(DFU_OP_WRITE, dfu, offset, buf, len);
+}
+
 static int mmc_file_buffer(struct dfu_entity *dfu, void *buf, long *len)
 {
 	if (dfu_file_buf_len + *len > CONFIG_SYS_DFU_MAX_FILE_SIZE) {
@@ -191,7 +465,7 @@ int dfu_write_medium_mmc(struct dfu_entity *dfu,
 
 	switch (dfu->layout) {
 	case DFU_RAW_ADDR:
-		ret = mmc_block_op(DFU_OP_WRITE, dfu, offset, buf, len);
+		ret = mmc_raw_write(dfu, offset, buf, len);
 		break;
 	case DFU_FS_FAT:
 	case DFU_FS_EXT4:
@@ -209,7 +483,14 @@ int dfu_flush_medium_mmc(struct dfu_entity *dfu)
 {
 	int ret = 0;
 
-	if (dfu->layout != DFU_RAW_ADDR) {
+	if (dfu->layout == DFU_RAW_ADDR) {
+		if (dfu_sparse.state != SPARSE_NONE &&
+		    (dfu_sparse.state != SPARSE_DONE || dfu_sparse.skip)) {
+			error("Sparse image incomplete");
+			ret = -EINVAL;
+		}
+		dfu_sparse.state = SPARSE_NONE;
+	} else {
 		/* Do stuff here. */
 		ret = mmc_file_op(DFU_OP_WRITE, dfu, dfu_file_buf,
 				&dfu_file_buf_len);
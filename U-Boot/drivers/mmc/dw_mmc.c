@@ -15,9 +15,26 @@
 #include <dwmmc.h>
 #include <asm-generic/errno.h>
 
-#define PAGE_SIZE 4096
+/* bytes covered by one IDMAC descriptor */
+#define DWMCI_IDMAC_BUF_SIZE	4096
 
-static int dwmci_wait_reset(struct dwmci_host *host, u32 value)
+/*
+ * A transfer is mapped in up to three segments: the cache aligned middle
+ * of the caller's buffer is used for DMA in place, and for reads into an
+ * unaligned buffer the partial cache lines at the head and tail are
+ * bounced through host->align_buf.
+ */
+struct dwmci_dma_map {
+	void *buf;		/* caller's buffer */
+	void *dma;		/* buffer handed to the IDMAC */
+	size_t len;
+	unsigned int head;
+	unsigned int tail;
+	bool bounce;		/* whole transfer bounced */
+	struct bounce_buffer bbstate;
+};
+
+int dwmci_wait_reset(struct dwmci_host *host, u32 value)
 {
 	unsigned long timeout = 1000;
 	u32 ctrl;
@@ -32,55 +49,147 @@ static int dwmci_wait_reset(struct dwmci_host *host, u32 value)
 	return 0;
 }
 
-static void dwmci_set_idma_desc(struct dwmci_idmac *idmac,
-		u32 desc0, u32 desc1, u32 desc2)
+static int dwmci_alloc_idmac(struct dwmci_host *host)
 {
-	struct dwmci_idmac *desc = idmac;
+	/* b_max blocks plus the head and tail segments */
+	host->idmac_cnt = DIV_ROUND_UP(host->cfg.b_max * 512,
+				       DWMCI_IDMAC_BUF_SIZE) + 2;
+	host->idmac = malloc_cache_aligned(host->idmac_cnt *
+					   sizeof(struct dwmci_idmac));
+	host->align_buf = malloc_cache_aligned(2 * ARCH_DMA_MINALIGN);
+	if (!host->idmac || !host->align_buf) {
+		free(host->idmac);
+		free(host->align_buf);
+		host->idmac = NULL;
+		host->align_buf = NULL;
+		return -ENOMEM;
+	}
 
-	desc->flags = desc0;
-	desc->cnt = desc1;
-	desc->addr = desc2;
-	desc->next_addr = (ulong)desc + sizeof(struct dwmci_idmac);
+	return 0;
+}
+
+static int dwmci_dma_map(struct dwmci_host *host, struct mmc_data *data,
+			 struct dwmci_dma_map *map)
+{
+	const ulong mask = ARCH_DMA_MINALIGN - 1;
+	ulong start, end;
+
+	map->len = data->blocksize * data->blocks;
+	map->head = 0;
+	map->tail = 0;
+	map->bounce = false;
+
+	if (data->flags == MMC_DATA_READ)
+		map->buf = data->dest;
+	else
+		map->buf = (void *)data->src;
+	map->dma = map->buf;
+
+	/* the IDMAC can only address word aligned buffers */
+	if ((ulong)map->buf & 3) {
+		map->bounce = true;
+		if (bounce_buffer_start(&map->bbstate, map->buf, map->len,
+					data->flags == MMC_DATA_READ ?
+					GEN_BB_WRITE : GEN_BB_READ))
+			return -ENOMEM;
+		map->dma = map->bbstate.bounce_buffer;
+		return 0;
+	}
+
+	start = (ulong)map->buf;
+	end = start + map->len;
+
+	if (data->flags != MMC_DATA_READ) {
+		/* cleaning partial lines is harmless, DMA only reads them */
+		flush_dcache_range(start & ~mask, (end + mask) & ~mask);
+		return 0;
+	}
+
+	map->head = min((size_t)((ARCH_DMA_MINALIGN - (start & mask)) & mask),
+			map->len);
+	if (map->len > map->head)
+		map->tail = end & mask;
+
+	if (map->head || map->tail)
+		flush_dcache_range((ulong)host->align_buf,
+				   (ulong)host->align_buf +
+				   2 * ARCH_DMA_MINALIGN);
+	if (start + map->head < end - map->tail)
+		flush_dcache_range(start + map->head, end - map->tail);
+
+	return 0;
+}
+
+static void dwmci_dma_unmap(struct dwmci_host *host, struct mmc_data *data,
+			    struct dwmci_dma_map *map)
+{
+	ulong start = (ulong)map->buf;
+	ulong end = start + map->len;
+
+	if (map->bounce) {
+		bounce_buffer_stop(&map->bbstate);
+		return;
+	}
+
+	if (data->flags != MMC_DATA_READ)
+		return;
+
+	if (start + map->head < end - map->tail)
+		invalidate_dcache_range(start + map->head, end - map->tail);
+
+	if (map->head || map->tail) {
+		invalidate_dcache_range((ulong)host->align_buf,
+					(ulong)host->align_buf +
+					2 * ARCH_DMA_MINALIGN);
+		memcpy(map->buf, host->align_buf, map->head);
+		memcpy(map->buf + map->len - map->tail,
+		       host->align_buf + ARCH_DMA_MINALIGN, map->tail);
+	}
+}
+
+static struct dwmci_idmac *dwmci_set_idma_seg(struct dwmci_idmac *desc,
+					      ulong addr, size_t len)
+{
+	size_t cnt;
+
+	while (len) {
+		cnt = min(len, (size_t)DWMCI_IDMAC_BUF_SIZE);
+
+		desc->flags = DWMCI_IDMAC_OWN | DWMCI_IDMAC_CH;
+		desc->cnt = cnt;
+		desc->addr = addr;
+		desc->next_addr = (ulong)(desc + 1);
+
+		addr += cnt;
+		len -= cnt;
+		desc++;
+	}
+
+	return desc;
 }
 
 static void dwmci_prepare_data(struct dwmci_host *host,
 			       struct mmc_data *data,
-			       struct dwmci_idmac *cur_idmac,
-			       void *bounce_buffer)
+			       struct dwmci_dma_map *map)
 {
+	struct dwmci_idmac *desc = host->idmac;
 	unsigned long ctrl;
-	unsigned int i = 0, flags, cnt, blk_cnt;
-	ulong data_start, data_end;
-
-
-	blk_cnt = data->blocks;
 
 	dwmci_wait_reset(host, DWMCI_CTRL_FIFO_RESET);
 
-	data_start = (ulong)cur_idmac;
-	dwmci_writel(host, DWMCI_DBADDR, (ulong)cur_idmac);
+	dwmci_writel(host, DWMCI_DBADDR, (ulong)desc);
 
-	do {
-		flags = DWMCI_IDMAC_OWN | DWMCI_IDMAC_CH ;
-		flags |= (i == 0) ? DWMCI_IDMAC_FS : 0;
-		if (blk_cnt <= 8) {
-			flags |= DWMCI_IDMAC_LD;
-			cnt = data->blocksize * blk_cnt;
-		} else
-			cnt = data->blocksize * 8;
-
-		dwmci_set_idma_desc(cur_idmac, flags, cnt,
-				    (ulong)bounce_buffer + (i * PAGE_SIZE));
-
-		if (blk_cnt <= 8)
-			break;
-		blk_cnt -= 8;
-		cur_idmac++;
-		i++;
-	} while(1);
+	desc = dwmci_set_idma_seg(desc, (ulong)host->align_buf, map->head);
+	desc = dwmci_set_idma_seg(desc, (ulong)map->dma + map->head,
+				  map->len - map->head - map->tail);
+	desc = dwmci_set_idma_seg(desc, (ulong)host->align_buf +
+				  ARCH_DMA_MINALIGN, map->tail);
+
+	host->idmac[0].flags |= DWMCI_IDMAC_FS;
+	desc[-1].flags |= DWMCI_IDMAC_LD;
 
-	data_end = (ulong)cur_idmac;
-	flush_dcache_range(data_start, data_end + ARCH_DMA_MINALIGN);
+	flush_dcache_range((ulong)host->idmac,
+			   ALIGN((ulong)desc, ARCH_DMA_MINALIGN));
 
 	ctrl = dwmci_readl(host, DWMCI_CTRL);
 	ctrl |= DWMCI_IDMAC_EN | DWMCI_DMA_EN;
@@ -185,14 +294,12 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		struct mmc_data *data)
 {
 	struct dwmci_host *host = mmc->priv;
-	ALLOC_CACHE_ALIGN_BUFFER(struct dwmci_idmac, cur_idmac,
-				 data ? DIV_ROUND_UP(data->blocks, 8) : 0);
 	int ret = 0, flags = 0, i;
 	unsigned int timeout = 100000;
 	u32 retry = 10000;
 	u32 mask, ctrl;
 	ulong start = get_timer(0);
-	struct bounce_buffer bbstate;
+	struct dwmci_dma_map map;
 
 	while (dwmci_readl(host, DWMCI_STATUS) & DWMCI_BUSY) {
 		if (get_timer(start) > timeout) {
@@ -210,18 +317,17 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 				     data->blocksize * data->blocks);
 			dwmci_wait_reset(host, DWMCI_CTRL_FIFO_RESET);
 		} else {
-			if (data->flags == MMC_DATA_READ) {
-				bounce_buffer_start(&bbstate, (void*)data->dest,
-						data->blocksize *
-						data->blocks, GEN_BB_WRITE);
-			} else {
-				bounce_buffer_start(&bbstate, (void*)data->src,
-						data->blocksize *
-						data->blocks, GEN_BB_READ);
-			}
-			dwmci_prepare_data(host, data, cur_idmac,
-					   bbstate.bounce_buffer);
+			if (!host->idmac && dwmci_alloc_idmac(host))
+				return -ENOMEM;
+			if (dwmci_dma_map(host, data, &map))
+				return -ENOMEM;
+			dwmci_prepare_data(host, data, &map);
 		}
+
+		/* Only a write DMA from the caller's buffer needs no unmap */
+		if (host->fifo_mode || map.bounce ||
+		    !(data->flags & MMC_DATA_WRITE))
+			data->flags &= ~MMC_DATA_ASYNC;
 	}
 
 	dwmci_writel(host, DWMCI_CMDARG, cmd->cmdarg);
@@ -294,6 +400,10 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 		}
 	}
 
+	/* Left to dwmci_wait_data() */
+	if (data && (data->flags & MMC_DATA_ASYNC))
+		return 0;
+
 	if (data) {
 		ret = dwmci_data_transfer(host, data);
 
@@ -302,7 +412,7 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 			ctrl = dwmci_readl(host, DWMCI_CTRL);
 			ctrl &= ~(DWMCI_DMA_EN);
 			dwmci_writel(host, DWMCI_CTRL, ctrl);
-			bounce_buffer_stop(&bbstate);
+			dwmci_dma_unmap(host, data, &map);
 		}
 	}
 
@@ -311,6 +421,24 @@ static int dwmci_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 	return ret;
 }
 
+/* Finish the DMA write that dwmci_send_cmd() left running */
+static int dwmci_wait_data(struct mmc *mmc, struct mmc_data *data)
+{
+	struct dwmci_host *host = mmc->priv;
+	u32 ctrl;
+	int ret;
+
+	ret = dwmci_data_transfer(host, data);
+
+	ctrl = dwmci_readl(host, DWMCI_CTRL);
+	ctrl &= ~(DWMCI_DMA_EN);
+	dwmci_writel(host, DWMCI_CTRL, ctrl);
+
+	udelay(100);
+
+	return ret;
+}
+
 static int dwmci_setup_bus(struct dwmci_host *host, u32 freq)
 {
 	u32 div, status;
@@ -448,10 +576,22 @@ static int dwmci_init(struct mmc *mmc)
 	return 0;
 }
 
+static int dwmci_execute_tuning(struct mmc *mmc)
+{
+	struct dwmci_host *host = mmc->priv;
+
+	if (!host->execute_tuning)
+		return 0;
+
+	return host->execute_tuning(host);
+}
+
 static const struct mmc_ops dwmci_ops = {
 	.send_cmd	= dwmci_send_cmd,
 	.set_ios	= dwmci_set_ios,
 	.init		= dwmci_init,
+	.execute_tuning	= dwmci_execute_tuning,
+	.wait_data	= dwmci_wait_data,
 };
 
 int add_dwmci(struct dwmci_host *host, u32 max_clk, u32 min_clk)
@@ -108,10 +108,17 @@ int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 	return ret;
 }
 
+/*
+ * Wait up to 'timeout' ms for the card to be ready for data. It is polled
+ * at once and then at growing intervals up to 1 ms, so short busy times
+ * after a write are not rounded up to a whole millisecond.
+ */
 int mmc_send_status(struct mmc *mmc, int timeout)
 {
 	struct mmc_cmd cmd;
 	int err, retries = 5;
+	ulong start = get_timer(0);
+	uint delay = 1;
 #ifdef CONFIG_MMC_TRACE
 	int status;
 #endif
@@ -138,10 +145,14 @@ int mmc_send_status(struct mmc *mmc, int timeout)
 		} else if (--retries < 0)
 			return err;
 
-		if (timeout-- <= 0)
+		if (get_timer(start) >= timeout) {
+			timeout = 0;
 			break;
+		}
 
-		udelay(1000);
+		udelay(delay);
+		if (delay < 1000)
+			delay *= 2;
 	}
 
 #ifdef CONFIG_MMC_TRACE
@@ -253,6 +264,9 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		return 0;
 	}
 
+	if (mmc_write_finish(mmc))
+		return 0;
+
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		debug("%s: Failed to set blocklen\n", __func__);
 		return 0;
@@ -605,6 +619,12 @@ int mmc_switch_part(int dev_num, unsigned int part_num)
 	if (!mmc)
 		return -1;
 
+	ret = mmc_write_finish(mmc);
+	if (ret)
+		return ret;
+
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
 	ret = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_PART_CONF,
 			 (mmc->part_config & ~PART_ACCESS_MASK)
 			 | (part_num & PART_ACCESS_MASK));
@@ -1457,6 +1477,27 @@ static int mmc_startup(struct mmc *mmc)
 
 	mmc_set_clock(mmc, mmc->tran_speed);
 
+	/* Let the host find its sampling point at the final bus timing */
+	if (mmc->cfg->ops->execute_tuning) {
+		err = mmc->cfg->ops->execute_tuning(mmc);
+		if (err && mmc->ddr_mode) {
+			/* no usable window in DDR mode, fall back to SDR */
+			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_BUS_WIDTH,
+					 mmc->bus_width == 8 ?
+					 EXT_CSD_BUS_WIDTH_8 :
+					 EXT_CSD_BUS_WIDTH_4);
+			if (!err) {
+				mmc->ddr_mode = 0;
+				mmc_set_bus_width(mmc, mmc->bus_width);
+				err = mmc->cfg->ops->execute_tuning(mmc);
+			}
+		}
+		/* the host keeps its default timing if tuning fails */
+		if (err)
+			debug("%s: tuning failed (%d)\n", __func__, err);
+	}
+
 	/* Fix the block length for DDR mode */
 	if (mmc->ddr_mode) {
 		mmc->read_bl_len = MMC_MAX_BLOCK_LEN;
@@ -1675,6 +1716,9 @@ int mmc_init(struct mmc *mmc)
 	if (mmc->has_init)
 		return 0;
 
+	/* "mmc rescan", or another card */
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 	start = get_timer(0);
 
 	if (!mmc->init_in_progress)
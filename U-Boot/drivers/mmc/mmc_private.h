@@ -27,6 +27,8 @@ extern unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt);
 extern ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt,
 		const void *src);
 
+int mmc_write_finish(struct mmc *mmc);
+
 #else /* CONFIG_SPL_BUILD */
 
 /* SPL will never write or erase, declare dummies to reduce code size. */
@@ -43,6 +45,11 @@ static inline ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt,
 	return 0;
 }
 
+static inline int mmc_write_finish(struct mmc *mmc)
+{
+	return 0;
+}
+
 #endif /* CONFIG_SPL_BUILD */
 
 #endif /* _MMC_PRIVATE_H_ */
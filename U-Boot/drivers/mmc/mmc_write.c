@@ -76,6 +76,11 @@ unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 	if (!mmc)
 		return -1;
 
+	if (mmc_write_finish(mmc))
+		return 0;
+
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
 	/*
 	 * We want to see if the requested start or total block count are
 	 * unaligned.  We discard the whole numbers and only care about the
@@ -108,13 +113,102 @@ unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
-static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
-		lbaint_t blkcnt, const void *src)
+/* Whether a multi-block write can be preceded by CMD23 SET_BLOCK_COUNT */
+static bool mmc_can_set_block_count(struct mmc *mmc)
+{
+	if (mmc_host_is_spi(mmc))
+		return false;
+	if (IS_SD(mmc))
+		return mmc->scr[0] & SD_SCR_CMD23_SUPPORT;
+
+	return mmc->version >= MMC_VERSION_3;
+}
+
+/*
+ * Announce the length of the next multi-block write: to an SD card as the
+ * number of blocks it may pre-erase (ACMD23), and with CMD23 to cards that
+ * take it, so the write ends by itself without CMD12. Only the latter is
+ * reported: the pre-erase count is a hint.
+ */
+static int mmc_set_block_count(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+
+	if (IS_SD(mmc) && !mmc_host_is_spi(mmc)) {
+		cmd.cmdidx = MMC_CMD_APP_CMD;
+		cmd.cmdarg = mmc->rca << 16;
+		cmd.resp_type = MMC_RSP_R1;
+		if (!mmc_send_cmd(mmc, &cmd, NULL)) {
+			cmd.cmdidx = SD_CMD_APP_SET_WR_BLK_ERASE_COUNT;
+			cmd.cmdarg = min_t(lbaint_t, blkcnt, 0x7fffff);
+			if (mmc_send_cmd(mmc, &cmd, NULL))
+				debug("%s: pre-erase count not taken\n",
+				      __func__);
+		}
+	}
+
+	if (blkcnt > 0xffff || !mmc_can_set_block_count(mmc))
+		return -EOPNOTSUPP;
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = blkcnt;
+	cmd.resp_type = MMC_RSP_R1;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
+/*
+ * End the last write: wait for its data if the host left it running,
+ * stop the transfer if its length was not set ahead, and wait until
+ * the card has programmed it
+ */
+static int mmc_write_end(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
-	struct mmc_data data;
 	int timeout = 1000;
 
+	if (mmc->write_busy) {
+		mmc->write_busy = 0;
+		if (mmc->cfg->ops->wait_data(mmc, &mmc->write_data)) {
+			mmc->write_stop = 0;
+			printf("mmc write failed\n");
+			return -EIO;
+		}
+	}
+
+	if (mmc->write_stop) {
+		mmc->write_stop = 0;
+		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+		cmd.cmdarg = 0;
+		cmd.resp_type = MMC_RSP_R1b;
+		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+			printf("mmc fail to send stop cmd\n");
+			return -EIO;
+		}
+	}
+
+	/* Waiting for the ready status */
+	if (mmc_send_status(mmc, timeout))
+		return -ETIMEDOUT;
+
+	return 0;
+}
+
+/* Finish a write left running by mmc_bwrite_start(), if any */
+int mmc_write_finish(struct mmc *mmc)
+{
+	if (!mmc->write_busy)
+		return 0;
+
+	return mmc_write_end(mmc);
+}
+
+static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
+		lbaint_t blkcnt, const void *src, bool async)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data *data = &mmc->write_data;
+
 	if ((start + blkcnt) > mmc->block_dev.lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
 		       start + blkcnt, mmc->block_dev.lba);
@@ -128,6 +222,14 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	else
 		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
 
+	/*
+	 * SPI multiblock writes terminate using a special token, otherwise
+	 * by the block count set ahead or a STOP_TRANSMISSION request.
+	 */
+	mmc->write_stop = 0;
+	if (blkcnt > 1 && !mmc_host_is_spi(mmc))
+		mmc->write_stop = mmc_set_block_count(mmc, blkcnt) != 0;
+
 	if (mmc->high_capacity)
 		cmd.cmdarg = start;
 	else
@@ -135,37 +237,33 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 
 	cmd.resp_type = MMC_RSP_R1;
 
-	data.src = src;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->write_bl_len;
-	data.flags = MMC_DATA_WRITE;
+	data->src = src;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->write_bl_len;
+	data->flags = MMC_DATA_WRITE;
+	if (async && mmc->cfg->ops->wait_data)
+		data->flags |= MMC_DATA_ASYNC;
 
-	if (mmc_send_cmd(mmc, &cmd, &data)) {
+	if (mmc_send_cmd(mmc, &cmd, data)) {
+		mmc->write_stop = 0;
 		printf("mmc write failed\n");
 		return 0;
 	}
 
-	/* SPI multiblock writes terminate using a special
-	 * token, not a STOP_TRANSMISSION request.
-	 */
-	if (!mmc_host_is_spi(mmc) && blkcnt > 1) {
-		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
-		cmd.cmdarg = 0;
-		cmd.resp_type = MMC_RSP_R1b;
-		if (mmc_send_cmd(mmc, &cmd, NULL)) {
-			printf("mmc fail to send stop cmd\n");
-			return 0;
-		}
+	/* The host kept the flag if the data is still moving */
+	if (data->flags & MMC_DATA_ASYNC) {
+		mmc->write_busy = 1;
+		return blkcnt;
 	}
 
-	/* Waiting for the ready status */
-	if (mmc_send_status(mmc, timeout))
+	if (mmc_write_end(mmc))
 		return 0;
 
 	return blkcnt;
 }
 
-ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
+static ulong mmc_bwrite_blocks(int dev_num, lbaint_t start, lbaint_t blkcnt,
+			       const void *src, bool async)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
 
@@ -173,13 +271,20 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 	if (!mmc)
 		return 0;
 
+	if (mmc_write_finish(mmc))
+		return 0;
+
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
 		return 0;
 
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
 			mmc->cfg->b_max : blocks_todo;
-		if (mmc_write_blocks(mmc, start, cur, src) != cur)
+		/* Only the last transfer may be left running */
+		if (mmc_write_blocks(mmc, start, cur, src,
+				     async && cur == blocks_todo) != cur)
 			return 0;
 		blocks_todo -= cur;
 		start += cur;
@@ -188,3 +293,45 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 
 	return blkcnt;
 }
+
+ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
+{
+	return mmc_bwrite_blocks(dev_num, start, blkcnt, src, false);
+}
+
+/**
+ * mmc_bwrite_start() - Write blocks, leaving the last transfer running
+ *
+ * On a host that can, this returns while the data of the last transfer
+ * still moves, so the caller can prepare the next blocks meanwhile. The
+ * buffer must not change until mmc_bwrite_wait(). The next access to the
+ * device through the block functions waits for the write first; nothing
+ * else may be sent to the device until then.
+ *
+ * @dev_num:	Device number
+ * @start:	First block to write
+ * @blkcnt:	Number of blocks
+ * @src:	Data
+ * @return @blkcnt if the write was started, else 0
+ */
+ulong mmc_bwrite_start(int dev_num, lbaint_t start, lbaint_t blkcnt,
+		       const void *src)
+{
+	return mmc_bwrite_blocks(dev_num, start, blkcnt, src, true);
+}
+
+/**
+ * mmc_bwrite_wait() - Wait for the write of mmc_bwrite_start()
+ *
+ * @dev_num:	Device number
+ * @return 0 if the blocks were written, else a negative error
+ */
+int mmc_bwrite_wait(int dev_num)
+{
+	struct mmc *mmc = find_mmc_device(dev_num);
+
+	if (!mmc)
+		return -ENODEV;
+
+	return mmc_write_finish(mmc);
+}
@@ -7,9 +7,12 @@
 
 #include <common.h>
 #include <malloc.h>
+#include <memalign.h>
+#include <mmc.h>
 #include <dwmmc.h>
 #include <asm/arch/nexell.h>
 #include <asm/arch/clk.h>
+#include <asm/arch/mmc.h>
 #include <asm/arch/reset.h>
 #include <asm/arch/nx_gpio.h>
 #include <asm/arch/tieoff.h>
@@ -33,9 +36,21 @@ static char *NX_NAME = "NEXELL DWMMC";
 					((y & 0x03) << 16) |\
 					((a & 0xFF) << 8)  |\
 					((b & 0x03) << 24))
+#define NX_MMC_DRV_MASK			NX_MMC_CLK_DELAY(0xFF, 0x03, 0, 0)
+
+/* sample delay line sweep */
+#define NX_MMC_TUNING_TAPS		256
+#define NX_MMC_TUNING_STEP		8
+#define NX_MMC_TUNING_SHIFTS		4
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* CLKCTRL value from the device tree, per channel */
+static u32 nx_mmc_clk_delay[3];
+
+/* Tuned CLKCTRL value per channel, for SDR and DDR; 0 if not known */
+static u32 nx_mmc_tuned[3][2];
+
 /* FIXME : This func will be remove after support pinctrl.
  * set mmc pad alternative func.
  */
@@ -148,7 +163,188 @@ static void dw_mci_clk_delay(const void *blob, int node,
 
 	val = NX_MMC_CLK_DELAY(drive_delay, drive_shift,
 				sample_delay, sample_shift);
+	nx_mmc_clk_delay[host->dev_index] = val;
+	writel(val, (host->ioaddr + DWMCI_CLKCTRL));
+}
+
+static int dw_mci_tuning_test(struct dwmci_host *host, u32 clk_delay,
+			      const u8 *ref, u8 *buf)
+{
+	struct mmc *mmc = host->mmc;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int err;
+
+	writel(clk_delay, (host->ioaddr + DWMCI_CLKCTRL));
+
+	cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+	cmd.cmdarg = 0;
+	cmd.resp_type = MMC_RSP_R1;
+
+	data.dest = (char *)buf;
+	data.blocks = 1;
+	data.blocksize = mmc->read_bl_len;
+	data.flags = MMC_DATA_READ;
+
+	memset(buf, 0, mmc->read_bl_len);
+	err = mmc->cfg->ops->send_cmd(mmc, &cmd, &data);
+	if (err) {
+		/* drop whatever is left of the block and restart the IDMAC */
+		udelay(1000);
+		dwmci_wait_reset(host, dwmci_readl(host, DWMCI_CTRL) |
+				 DWMCI_CTRL_FIFO_RESET | DWMCI_CTRL_DMA_RESET);
+		dwmci_writel(host, DWMCI_BMOD, DWMCI_BMOD_IDMAC_RESET);
+		dwmci_writel(host, DWMCI_RINTSTS, DWMCI_INTMSK_ALL);
+		return 0;
+	}
+
+	return !ref || !memcmp(buf, ref, mmc->read_bl_len);
+}
+
+/*
+ * Sweep the sample phase for a drive setting and return the CLKCTRL
+ * value in the centre of the widest passing window, or -1.
+ */
+static int dw_mci_tuning_sample(struct dwmci_host *host, u32 drv,
+				const u8 *ref, u8 *buf)
+{
+	int shift, dly, start, len, mid, best = -1, best_len = 0;
+
+	for (shift = 0; shift < NX_MMC_TUNING_SHIFTS; shift++) {
+		start = -1;
+		for (dly = 0; dly <= NX_MMC_TUNING_TAPS;
+		     dly += NX_MMC_TUNING_STEP) {
+			if (dly < NX_MMC_TUNING_TAPS &&
+			    dw_mci_tuning_test(host, drv |
+					       NX_MMC_CLK_DELAY(0, 0, dly,
+								shift),
+					       ref, buf)) {
+				if (start < 0)
+					start = dly;
+				continue;
+			}
+			if (start < 0)
+				continue;
+
+			len = dly - start;
+			if (len > best_len) {
+				mid = start + ((len / NX_MMC_TUNING_STEP - 1)
+					       / 2) * NX_MMC_TUNING_STEP;
+				best_len = len;
+				best = drv | NX_MMC_CLK_DELAY(0, 0, mid, shift);
+			}
+			start = -1;
+		}
+	}
+
+	debug("DWMMC%d: drive 0x%x window %d taps\n", host->dev_index, drv,
+	      best_len);
+
+	return best;
+}
+
+/*
+ * Keep the tuned values of channel 'ch' in "mmc<n>_clkdly" and
+ * "mmc<n>_clkdly_ddr", once the environment is ready
+ */
+static void dw_mci_tuning_setenv(int ch)
+{
+	char name[24];
+	int ddr;
+
+	if (!(gd->flags & GD_FLG_ENV_READY))
+		return;
+
+	for (ddr = 0; ddr < 2; ddr++) {
+		if (!nx_mmc_tuned[ch][ddr])
+			continue;
+		sprintf(name, "mmc%d_clkdly%s", ch, ddr ? "_ddr" : "");
+		if (getenv_hex(name, 0) != nx_mmc_tuned[ch][ddr])
+			setenv_hex(name, nx_mmc_tuned[ch][ddr]);
+	}
+}
+
+/*
+ * The boot eMMC is tuned while the environment is read from it; put its
+ * values in the environment now that it is ready
+ */
+void nexell_mmc_tuning_setenv(void)
+{
+	int ch;
+
+	for (ch = 0; ch < ARRAY_SIZE(nx_mmc_tuned); ch++)
+		dw_mci_tuning_setenv(ch);
+}
+
+/*
+ * Pick the sampling point for the current bus timing. A value kept in
+ * the environment is tried first, then the one from the last init of
+ * the channel or from "nexell,tuned-clkdly" (or "-ddr") in the DT, and
+ * only if neither reads back is the sample delay swept.
+ */
+static int dw_mci_execute_tuning(struct dwmci_host *host)
+{
+	struct mmc *mmc = host->mmc;
+	ALLOC_CACHE_ALIGN_BUFFER(u8, ref, MMC_MAX_BLOCK_LEN);
+	ALLOC_CACHE_ALIGN_BUFFER(u8, buf, MMC_MAX_BLOCK_LEN);
+	u32 def = nx_mmc_clk_delay[host->dev_index];
+	u32 *tuned = &nx_mmc_tuned[host->dev_index][mmc->ddr_mode ? 1 : 0];
+	u32 drv = def & NX_MMC_DRV_MASK;
+	char name[24];
+	bool has_ref;
+	u32 saved;
+	int val, shift;
+
+	/* the device tree timing is used as is at legacy speeds */
+	if (mmc->clock <= 26000000)
+		return 0;
+
+	has_ref = dw_mci_tuning_test(host, def, NULL, ref);
+
+	if (gd->flags & GD_FLG_ENV_READY) {
+		sprintf(name, "mmc%d_clkdly%s", host->dev_index,
+			mmc->ddr_mode ? "_ddr" : "");
+		saved = getenv_hex(name, 0);
+		if (saved && saved != *tuned &&
+		    dw_mci_tuning_test(host, saved, has_ref ? ref : NULL,
+				       buf)) {
+			*tuned = saved;
+			return 0;
+		}
+	}
+
+	if (*tuned && dw_mci_tuning_test(host, *tuned, has_ref ? ref : NULL,
+					 buf)) {
+		dw_mci_tuning_setenv(host->dev_index);
+		return 0;
+	}
+
+	val = dw_mci_tuning_sample(host, drv, has_ref ? ref : NULL, buf);
+
+	/* a bad drive phase shows up as command errors on every sample */
+	for (shift = 0; val < 0 && shift < NX_MMC_TUNING_SHIFTS; shift++) {
+		if (shift == ((def >> 16) & 0x03))
+			continue;
+		drv = NX_MMC_CLK_DELAY(def & 0xFF, shift, 0, 0);
+		val = dw_mci_tuning_sample(host, drv, has_ref ? ref : NULL,
+					   buf);
+	}
+
+	if (val < 0) {
+		printf("DWMMC%d: no sample window at %d Hz%s\n",
+		       host->dev_index, mmc->clock,
+		       mmc->ddr_mode ? " DDR" : "");
+		writel(def, (host->ioaddr + DWMCI_CLKCTRL));
+		return -EIO;
+	}
+
 	writel(val, (host->ioaddr + DWMCI_CLKCTRL));
+	debug("DWMMC%d: CLKCTRL 0x%x\n", host->dev_index, val);
+
+	*tuned = val;
+	dw_mci_tuning_setenv(host->dev_index);
+
+	return 0;
 }
 static void dw_mci_reset(int ch)
 {
@@ -184,9 +380,18 @@ static int nexell_get_config(const void *blob, int node,
 	host->clksel = dw_mci_clksel;
 	host->dev_id = host->dev_index;
 	host->get_mmc_clk = dw_mci_get_clk;
+	host->execute_tuning = dw_mci_execute_tuning;
+	nx_mmc_tuned[host->dev_index][0] =
+		fdtdec_get_int(blob, node, "nexell,tuned-clkdly", 0);
+	nx_mmc_tuned[host->dev_index][1] =
+		fdtdec_get_int(blob, node, "nexell,tuned-clkdly-ddr", 0);
 	host->fifoth_val = MSIZE(0x2) | RX_WMARK(fifo_size/2 - 1)
 	| TX_WMARK(fifo_size/2);
 
+	/*
+	 * DDR52 only where the board asks for it; tuning falls back to SDR
+	 * when the wiring has no usable DDR sample window.
+	 */
 	if (fdtdec_get_int(blob, node, "nexell,ddr", 0))
 		host->caps |= MMC_MODE_DDR_52MHz;
 	return 0;
@@ -12,6 +12,7 @@
 #include <common.h>
 #include <dm.h>
 #include <errno.h>
+#include <fdtdec.h>
 #include <miiphy.h>
 #include <malloc.h>
 #include <pci.h>
@@ -23,7 +24,6 @@
 #include <asm/arch/clk.h>
 #include <asm/arch/nx_gpio.h>
 #include <asm/arch/reset.h>
-#include <fdtdec.h>
 #include <libfdt.h>
 #endif /* CONFIG_ARCH_NEXELL */
 #include "designware.h"
@@ -102,6 +102,74 @@ static int dw_mdio_init(const char *name, struct eth_mac_regs *mac_regs_p)
 	return mdio_register(bus);
 }
 
+/* The DMA takes 32-bit addresses, for descriptors and buffers alike */
+static bool dw_dma_reachable(const void *p, size_t size)
+{
+	return (u64)(ulong)p + size <= (1ULL << 32);
+}
+
+static int dw_alloc_rings(struct dw_eth_dev *priv, u32 tx_num, u32 rx_num)
+{
+	if (!tx_num || !rx_num)
+		return -EINVAL;
+
+	/* whole cache lines of Rx descriptors are returned at once */
+	rx_num = roundup(rx_num, DW_RX_DESCR_PER_LINE);
+
+	priv->tx_mac_descrtable = memalign(ARCH_DMA_MINALIGN, tx_num *
+					   sizeof(struct dmamacdescr));
+	priv->rx_mac_descrtable = memalign(ARCH_DMA_MINALIGN, rx_num *
+					   sizeof(struct dmamac_rxdescr));
+	priv->txbuffs = memalign(ARCH_DMA_MINALIGN,
+				 tx_num * CONFIG_ETH_BUFSIZE);
+	priv->rxbuffs = memalign(ARCH_DMA_MINALIGN,
+				 rx_num * CONFIG_ETH_BUFSIZE);
+	if (!priv->tx_mac_descrtable || !priv->rx_mac_descrtable ||
+	    !priv->txbuffs || !priv->rxbuffs)
+		return -ENOMEM;
+#ifdef CONFIG_NET_RX_PLACE
+	priv->rx_place = calloc(rx_num, sizeof(*priv->rx_place));
+	if (!priv->rx_place)
+		return -ENOMEM;
+#endif
+
+	if (!dw_dma_reachable(priv->tx_mac_descrtable,
+			      tx_num * sizeof(struct dmamacdescr)) ||
+	    !dw_dma_reachable(priv->rx_mac_descrtable,
+			      rx_num * sizeof(struct dmamac_rxdescr)) ||
+	    !dw_dma_reachable(priv->txbuffs, tx_num * CONFIG_ETH_BUFSIZE) ||
+	    !dw_dma_reachable(priv->rxbuffs, rx_num * CONFIG_ETH_BUFSIZE)) {
+		printf("designware: buffers are outside DMA memory\n");
+		return -EINVAL;
+	}
+
+	memset(priv->tx_mac_descrtable, 0, tx_num * sizeof(struct dmamacdescr));
+	memset(priv->rx_mac_descrtable, 0,
+	       rx_num * sizeof(struct dmamac_rxdescr));
+	memset(priv->rxbuffs, 0, rx_num * CONFIG_ETH_BUFSIZE);
+
+	priv->tx_descrnum = tx_num;
+	priv->rx_descrnum = rx_num;
+
+	return 0;
+}
+
+static void dw_free_rings(struct dw_eth_dev *priv)
+{
+	free(priv->tx_mac_descrtable);
+	free(priv->rx_mac_descrtable);
+	free(priv->txbuffs);
+	free(priv->rxbuffs);
+	priv->tx_mac_descrtable = NULL;
+	priv->rx_mac_descrtable = NULL;
+	priv->txbuffs = NULL;
+	priv->rxbuffs = NULL;
+#ifdef CONFIG_NET_RX_PLACE
+	free(priv->rx_place);
+	priv->rx_place = NULL;
+#endif
+}
+
 static void tx_descs_init(struct dw_eth_dev *priv)
 {
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
@@ -110,7 +178,7 @@ static void tx_descs_init(struct dw_eth_dev *priv)
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
-	for (idx = 0; idx < CONFIG_TX_DESCR_NUM; idx++) {
+	for (idx = 0; idx < priv->tx_descrnum; idx++) {
 		desc_p = &desc_table_p[idx];
 		desc_p->dmamac_addr = (ulong)&txbuffs[idx * CONFIG_ETH_BUFSIZE];
 		desc_p->dmamac_next = (ulong)&desc_table_p[idx + 1];
@@ -131,23 +199,78 @@ static void tx_descs_init(struct dw_eth_dev *priv)
 	}
 
 	/* Correcting the last pointer of the chain */
-	desc_p->dmamac_next = (ulong)&desc_table_p[0];
+	desc_table_p[priv->tx_descrnum - 1].dmamac_next =
+		(ulong)&desc_table_p[0];
 
 	/* Flush all Tx buffer descriptors at once */
 	flush_dcache_range((ulong)priv->tx_mac_descrtable,
-			   (ulong)priv->tx_mac_descrtable +
-			   sizeof(priv->tx_mac_descrtable));
+			   (ulong)&priv->tx_mac_descrtable[priv->tx_descrnum]);
 
 	writel((ulong)&desc_table_p[0], &dma_p->txdesclistaddr);
 	priv->tx_currdescnum = 0;
 }
 
+/*
+ * Point Rx descriptor idx at its own buffer or, when the placer has an
+ * address for the frame that will arrive in it, split that frame between
+ * the buffer and the placed address. ahead is the number of frames that
+ * arrive before that one, 0 to never place.
+ */
+static void rx_desc_setup(struct dw_eth_dev *priv, u32 idx, int ahead)
+{
+	struct dmamac_rxdescr *desc_p = &priv->rx_mac_descrtable[idx];
+	uchar *dst = NULL;
+	int lead = 0;
+	u32 cntl;
+
+	desc_p->dmamac_addr = (ulong)&priv->rxbuffs[idx * CONFIG_ETH_BUFSIZE];
+
+#ifdef CONFIG_NET_RX_PLACE
+	/* A placed address that was never used goes back to the placer */
+	if (priv->rx_place[idx] && net_rx_placer)
+		net_rx_placer->placed(NULL, 0, priv->rx_place[idx]);
+
+	if (ahead && net_rx_placer && net_rx_placer->hdr_len +
+	    DW_RX_PLACE_ALIGN - 1 <= DW_RX_PLACE_HDR) {
+		lead = DW_RX_PLACE_HDR - net_rx_placer->hdr_len;
+		dst = net_rx_placer->place(ahead, lead + DW_RX_PLACE_SIZE);
+		if (dst) {
+			/*
+			 * Start the frame that much further into buffer 1
+			 * that the payload following it is on a bus width
+			 * boundary at the placed address
+			 */
+			int skip = ((ulong)dst + lead) % DW_RX_PLACE_ALIGN;
+
+			desc_p->dmamac_addr += skip;
+			lead -= skip;
+		}
+	}
+	priv->rx_place[idx] = dst;
+#endif
+
+	if (dst) {
+		desc_p->dmamac_next = (ulong)dst + lead;
+		cntl = ((DW_RX_PLACE_HDR << DESC_RXCTRL_SIZE1SHFT) &
+			DESC_RXCTRL_SIZE1MASK) |
+		       ((DW_RX_PLACE_SIZE << DESC_RXCTRL_SIZE2SHFT) &
+			DESC_RXCTRL_SIZE2MASK);
+	} else {
+		desc_p->dmamac_next = 0;
+		cntl = MAC_MAX_FRAME_SZ & DESC_RXCTRL_SIZE1MASK;
+	}
+
+	if (idx == priv->rx_descrnum - 1)
+		cntl |= DESC_RXCTRL_RXRINGEND;
+	desc_p->dmamac_cntl = cntl;
+}
+
 static void rx_descs_init(struct dw_eth_dev *priv)
 {
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
-	struct dmamacdescr *desc_table_p = &priv->rx_mac_descrtable[0];
+	struct dmamac_rxdescr *desc_table_p = &priv->rx_mac_descrtable[0];
 	char *rxbuffs = &priv->rxbuffs[0];
-	struct dmamacdescr *desc_p;
+	struct dmamac_rxdescr *desc_p;
 	u32 idx;
 
 	/* Before passing buffers to GMAC we need to make sure zeros
@@ -156,27 +279,18 @@ static void rx_descs_init(struct dw_eth_dev *priv)
 	 * Otherwise there's a chance to get some of them flushed in RAM when
 	 * GMAC is already pushing data to RAM via DMA. This way incoming from
 	 * GMAC data will be corrupted. */
-	flush_dcache_range((ulong)rxbuffs, (ulong)rxbuffs + RX_TOTAL_BUFSIZE);
+	flush_dcache_range((ulong)rxbuffs, (ulong)rxbuffs +
+			   priv->rx_descrnum * CONFIG_ETH_BUFSIZE);
 
-	for (idx = 0; idx < CONFIG_RX_DESCR_NUM; idx++) {
+	for (idx = 0; idx < priv->rx_descrnum; idx++) {
 		desc_p = &desc_table_p[idx];
-		desc_p->dmamac_addr = (ulong)&rxbuffs[idx * CONFIG_ETH_BUFSIZE];
-		desc_p->dmamac_next = (ulong)&desc_table_p[idx + 1];
-
-		desc_p->dmamac_cntl =
-			(MAC_MAX_FRAME_SZ & DESC_RXCTRL_SIZE1MASK) |
-				      DESC_RXCTRL_RXCHAIN;
-
+		rx_desc_setup(priv, idx, 0);
 		desc_p->txrx_status = DESC_RXSTS_OWNBYDMA;
 	}
 
-	/* Correcting the last pointer of the chain */
-	desc_p->dmamac_next = (ulong)&desc_table_p[0];
-
 	/* Flush all Rx buffer descriptors at once */
 	flush_dcache_range((ulong)priv->rx_mac_descrtable,
-			   (ulong)priv->rx_mac_descrtable +
-			   sizeof(priv->rx_mac_descrtable));
+			   (ulong)&priv->rx_mac_descrtable[priv->rx_descrnum]);
 
 	writel((ulong)&desc_table_p[0], &dma_p->rxdesclistaddr);
 	priv->rx_currdescnum = 0;
@@ -346,7 +460,7 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	flush_dcache_range(desc_start, desc_end);
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_TX_DESCR_NUM)
+	if (++desc_num >= priv->tx_descrnum)
 		desc_num = 0;
 
 	priv->tx_currdescnum = desc_num;
@@ -357,21 +471,150 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	return 0;
 }
 
+#ifdef CONFIG_NET_RX_PLACE
+/* Bytes of a placed frame in buffer 1, which starts 'skip' bytes in */
+static int rx_place_fill(struct dmamac_rxdescr *desc_p)
+{
+	return DW_RX_PLACE_HDR - desc_p->dmamac_addr % DW_RX_PLACE_ALIGN;
+}
+
+/* Copy the payload of a placed frame back behind its headers */
+static void rx_place_join(struct dw_eth_dev *priv, u32 idx, int length)
+{
+	struct dmamac_rxdescr *desc_p = &priv->rx_mac_descrtable[idx];
+	uchar *buf = (uchar *)(ulong)desc_p->dmamac_addr;
+	uchar *data = (uchar *)(ulong)desc_p->dmamac_next;
+	int fill = rx_place_fill(desc_p);
+	int tail = min(length - fill, DW_RX_PLACE_SIZE);
+
+	if (tail <= 0)
+		return;
+
+	invalidate_dcache_range(rounddown((ulong)buf, ARCH_DMA_MINALIGN),
+				roundup((ulong)buf + fill, ARCH_DMA_MINALIGN));
+	invalidate_dcache_range(rounddown((ulong)data, ARCH_DMA_MINALIGN),
+				roundup((ulong)data + tail, ARCH_DMA_MINALIGN));
+	memcpy(buf + fill, data, tail);
+	/* The buffer goes back to the DMA, leave no dirty lines behind */
+	flush_dcache_range(rounddown((ulong)buf, ARCH_DMA_MINALIGN),
+			   roundup((ulong)buf + fill + tail,
+				   ARCH_DMA_MINALIGN));
+}
+
+/*
+ * Stop the Rx DMA and point every placed descriptor it still owns back at
+ * its own buffer. Frames that already arrived in placed descriptors are
+ * joined up now, so that nothing is read from the placed addresses later.
+ */
+static int _dw_rx_unplace(struct dw_eth_dev *priv)
+{
+	struct eth_dma_regs *dma_p = priv->dma_regs_p;
+	struct dmamac_rxdescr *desc_p;
+	u32 opmode = readl(&dma_p->opmode);
+	ulong start, line;
+	u32 idx, status;
+
+	/* The DMA completes the frame it is on before it stops */
+	writel(opmode & ~RXSTART, &dma_p->opmode);
+
+	start = get_timer(0);
+	while (readl(&dma_p->status) & RXSTATEMASK) {
+		if (get_timer(start) >= CONFIG_MACRESET_TIMEOUT) {
+			printf("Rx DMA stop timeout\n");
+			return -ETIMEDOUT;
+		}
+		udelay(10);
+	}
+
+	for (idx = 0; idx < priv->rx_descrnum; idx++) {
+		if (!priv->rx_place[idx])
+			continue;
+
+		desc_p = &priv->rx_mac_descrtable[idx];
+		line = rounddown((ulong)desc_p, ARCH_DMA_MINALIGN);
+		invalidate_dcache_range(line, line + ARCH_DMA_MINALIGN);
+		status = desc_p->txrx_status;
+
+		if (status & DESC_RXSTS_OWNBYDMA) {
+			rx_desc_setup(priv, idx, 0);
+			flush_dcache_range(line, line + ARCH_DMA_MINALIGN);
+		} else {
+			rx_place_join(priv, idx, (status &
+				      DESC_RXSTS_FRMLENMSK) >>
+				      DESC_RXSTS_FRMLENSHFT);
+			if (net_rx_placer)
+				net_rx_placer->placed(NULL, 0,
+						      priv->rx_place[idx]);
+			priv->rx_place[idx] = NULL;
+		}
+	}
+
+	if (opmode & RXSTART)
+		writel(opmode, &dma_p->opmode);
+
+	return 0;
+}
+/*
+ * A placed descriptor came back. If the placer recognizes the frame, its
+ * payload is already in place but for the first bytes, which landed in the
+ * Rx buffer behind the headers. Otherwise the payload is copied back behind
+ * the headers and the frame goes up like any other. The other placed
+ * descriptors stay as they are: a frame of theirs that does not match
+ * goes the same way, and the placer takes them back itself before it
+ * copies a block over one of their addresses.
+ */
+static void rx_placed(struct dw_eth_dev *priv, u32 desc_num, int length)
+{
+	struct net_rx_placer *placer = net_rx_placer;
+	struct dmamac_rxdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	uchar *buf = (uchar *)(ulong)desc_p->dmamac_addr;
+	uchar *dst = priv->rx_place[desc_num];
+	int fill = rx_place_fill(desc_p);
+	int lead = desc_p->dmamac_next - (ulong)dst;
+
+	invalidate_dcache_range(rounddown((ulong)buf, ARCH_DMA_MINALIGN),
+				roundup((ulong)buf + fill, ARCH_DMA_MINALIGN));
+
+	if (placer && placer->placed(buf, length, dst)) {
+		invalidate_dcache_range(rounddown((ulong)dst,
+						  ARCH_DMA_MINALIGN),
+					roundup((ulong)dst + lead + length -
+						fill, ARCH_DMA_MINALIGN));
+		memcpy(dst, buf + fill - lead, lead);
+		flush_dcache_range(rounddown((ulong)dst, ARCH_DMA_MINALIGN),
+				   roundup((ulong)dst + lead,
+					   ARCH_DMA_MINALIGN));
+		net_rx_placed_data = dst;
+		priv->rx_place[desc_num] = NULL;
+	} else {
+		rx_place_join(priv, desc_num, length);
+		priv->rx_place[desc_num] = NULL;
+	}
+}
+
+#endif
+
 static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
 {
 	u32 status, desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	struct dmamac_rxdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
 	int length = -EAGAIN;
-	ulong desc_start = (ulong)desc_p;
-	ulong desc_end = desc_start +
-		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
+	ulong desc_start = rounddown((ulong)desc_p, ARCH_DMA_MINALIGN);
+	ulong desc_end = desc_start + ARCH_DMA_MINALIGN;
 	ulong data_start = desc_p->dmamac_addr;
 	ulong data_end;
 
-	/* Invalidate entire buffer descriptor */
-	invalidate_dcache_range(desc_start, desc_end);
-
+	/*
+	 * A descriptor handed back by the DMA does not change again until
+	 * it is returned, so the cache line, and with it the following
+	 * descriptors of a burst, is only re-read while this one still
+	 * looks owned by the DMA.
+	 */
 	status = desc_p->txrx_status;
+	if (status & DESC_RXSTS_OWNBYDMA) {
+		invalidate_dcache_range(desc_start, desc_end);
+		status = desc_p->txrx_status;
+	}
 
 	/* Check  if the owner is the CPU */
 	if (!(status & DESC_RXSTS_OWNBYDMA)) {
@@ -379,9 +622,17 @@ static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
 		length = (status & DESC_RXSTS_FRMLENMSK) >>
 			 DESC_RXSTS_FRMLENSHFT;
 
-		/* Invalidate received data */
-		data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
-		invalidate_dcache_range(data_start, data_end);
+#ifdef CONFIG_NET_RX_PLACE
+		if (priv->rx_place[desc_num])
+			rx_placed(priv, desc_num, length);
+		else
+#endif
+		{
+			/* Invalidate received data */
+			data_end = data_start +
+				roundup(length, ARCH_DMA_MINALIGN);
+			invalidate_dcache_range(data_start, data_end);
+		}
 		*packetp = (uchar *)(ulong)desc_p->dmamac_addr;
 	}
 
@@ -390,23 +641,42 @@ static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
 
 static int _dw_free_pkt(struct dw_eth_dev *priv)
 {
+	struct eth_dma_regs *dma_p = priv->dma_regs_p;
 	u32 desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
-	ulong desc_start = (ulong)desc_p;
-	ulong desc_end = desc_start +
-		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
+	struct dmamac_rxdescr *desc_p;
+	int ahead;
+	u32 idx;
+
+#ifdef CONFIG_NET_RX_PLACE
+	net_rx_placed_data = NULL;
+#endif
 
 	/*
-	 * Make the current descriptor valid again and go to
-	 * the next one
+	 * Return the descriptors once the last one of their cache line is
+	 * consumed; flushing a partially consumed line could overwrite
+	 * status the DMA is writing to its neighbours. Each one receives a
+	 * frame again after all the others in the ring.
 	 */
-	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+	if (!((desc_num + 1) % DW_RX_DESCR_PER_LINE)) {
+		idx = desc_num + 1 - DW_RX_DESCR_PER_LINE;
+		desc_p = &priv->rx_mac_descrtable[idx];
+		ahead = priv->rx_descrnum - DW_RX_DESCR_PER_LINE + 1;
+
+		for (; idx <= desc_num; idx++) {
+			rx_desc_setup(priv, idx, ahead++);
+			priv->rx_mac_descrtable[idx].txrx_status |=
+				DESC_RXSTS_OWNBYDMA;
+		}
 
-	/* Flush only status field - others weren't changed */
-	flush_dcache_range(desc_start, desc_end);
+		flush_dcache_range((ulong)desc_p, (ulong)desc_p +
+				   ARCH_DMA_MINALIGN);
+
+		/* Resume reception if the ring had run full */
+		writel(POLL_DATA, &dma_p->rxpolldemand);
+	}
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_RX_DESCR_NUM)
+	if (++desc_num >= priv->rx_descrnum)
 		desc_num = 0;
 	priv->rx_currdescnum = desc_num;
 
@@ -450,15 +720,20 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 
 static int dw_eth_recv(struct eth_device *dev)
 {
+	struct dw_eth_dev *priv = dev->priv;
 	uchar *packet;
 	int length;
+	u32 count;
 
-	length = _dw_eth_recv(dev->priv, &packet);
-	if (length == -EAGAIN)
-		return 0;
-	net_process_received_packet(packet, length);
+	/* Hand the whole run of completed frames up, at most one ring */
+	for (count = 0; count < priv->rx_descrnum; count++) {
+		length = _dw_eth_recv(priv, &packet);
+		if (length == -EAGAIN)
+			break;
+		net_process_received_packet(packet, length);
 
-	_dw_free_pkt(dev->priv);
+		_dw_free_pkt(priv);
+	}
 
 	return 0;
 }
@@ -493,14 +768,16 @@ int designware_initialize(ulong base_addr, u32 interface)
 		return -ENOMEM;
 	}
 
-	if ((phys_addr_t)priv + sizeof(*priv) > (1ULL << 32)) {
-		printf("designware: buffers are outside DMA memory\n");
-		return -EINVAL;
-	}
-
 	memset(dev, 0, sizeof(struct eth_device));
 	memset(priv, 0, sizeof(struct dw_eth_dev));
 
+	if (dw_alloc_rings(priv, CONFIG_TX_DESCR_NUM, CONFIG_RX_DESCR_NUM)) {
+		dw_free_rings(priv);
+		free(priv);
+		free(dev);
+		return -ENOMEM;
+	}
+
 	sprintf(dev->name, "dwmac.%lx", base_addr);
 	dev->iobase = (int)base_addr;
 	dev->priv = priv;
@@ -582,6 +859,15 @@ static int designware_eth_free_pkt(struct udevice *dev, uchar *packet,
 	return _dw_free_pkt(priv);
 }
 
+#ifdef CONFIG_NET_RX_PLACE
+static int designware_eth_rx_unplace(struct udevice *dev)
+{
+	struct dw_eth_dev *priv = dev_get_priv(dev);
+
+	return _dw_rx_unplace(priv);
+}
+#endif
+
 static void designware_eth_stop(struct udevice *dev)
 {
 	struct dw_eth_dev *priv = dev_get_priv(dev);
@@ -651,6 +937,16 @@ static int designware_eth_probe(struct udevice *dev)
 	priv->dma_regs_p = (struct eth_dma_regs *)(ioaddr + DW_DMA_BASE_OFFSET);
 	priv->interface = pdata->phy_interface;
 
+	ret = dw_alloc_rings(priv,
+			     fdtdec_get_int(gd->fdt_blob, dev->of_offset,
+					    "tx-desc-num", CONFIG_TX_DESCR_NUM),
+			     fdtdec_get_int(gd->fdt_blob, dev->of_offset,
+					    "rx-desc-num", CONFIG_RX_DESCR_NUM));
+	if (ret) {
+		dw_free_rings(priv);
+		return ret;
+	}
+
 	dw_mdio_init(dev->name, priv->mac_regs_p);
 	priv->bus = miiphy_get_dev_by_name(dev->name);
 
@@ -667,6 +963,7 @@ static int designware_eth_remove(struct udevice *dev)
 	free(priv->phydev);
 	mdio_unregister(priv->bus);
 	mdio_free(priv->bus);
+	dw_free_rings(priv);
 
 	return 0;
 }
@@ -678,6 +975,9 @@ static const struct eth_ops designware_eth_ops = {
 	.free_pkt		= designware_eth_free_pkt,
 	.stop			= designware_eth_stop,
 	.write_hwaddr		= designware_eth_write_hwaddr,
+#ifdef CONFIG_NET_RX_PLACE
+	.rx_unplace		= designware_eth_rx_unplace,
+#endif
 };
 
 static int designware_eth_ofdata_to_platdata(struct udevice *dev)
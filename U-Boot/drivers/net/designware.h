@@ -8,11 +8,14 @@
 #ifndef _DW_ETH_H
 #define _DW_ETH_H
 
+/* Default ring depths, "tx-desc-num"/"rx-desc-num" override them */
+#ifndef CONFIG_TX_DESCR_NUM
 #define CONFIG_TX_DESCR_NUM	16
-#define CONFIG_RX_DESCR_NUM	16
+#endif
+#ifndef CONFIG_RX_DESCR_NUM
+#define CONFIG_RX_DESCR_NUM	64
+#endif
 #define CONFIG_ETH_BUFSIZE	2048
-#define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
-#define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
 
 #define CONFIG_MACRESET_TIMEOUT	(3 * CONFIG_SYS_HZ)
 #define CONFIG_MDIO_TIMEOUT	(3 * CONFIG_SYS_HZ)
@@ -97,6 +100,9 @@ struct eth_dma_regs {
 /* Poll demand definitions */
 #define POLL_DATA		(0xFFFFFFFF)
 
+/* Status definitions */
+#define RXSTATEMASK		(7 << 17)
+
 /* Operation mode definitions */
 #define STOREFORWARD		(1 << 21)
 #define FLUSHTXFIFO		(1 << 20)
@@ -114,6 +120,38 @@ struct dmamacdescr {
 	u32 dmamac_next;
 } __aligned(ARCH_DMA_MINALIGN);
 
+/*
+ * Rx descriptors are packed so that one cache maintenance operation
+ * covers DW_RX_DESCR_PER_LINE of them. They are only handed back to the
+ * DMA a whole cache line at a time.
+ */
+struct dmamac_rxdescr {
+	u32 txrx_status;
+	u32 dmamac_cntl;
+	u32 dmamac_addr;
+	u32 dmamac_next;
+};
+
+#define DW_RX_DESCR_PER_LINE	\
+	(ARCH_DMA_MINALIGN / sizeof(struct dmamac_rxdescr))
+
+/*
+ * The Rx ring runs in ring mode, dmamac_next is the second buffer. A
+ * descriptor set up from net_rx_placer gets the headers of its frame in
+ * its own buffer (a multiple of the bus width, so the first payload bytes
+ * land there too) and the rest, up to a full VLAN frame, at the placed
+ * address.
+ */
+#define DW_RX_PLACE_HDR		56
+#define DW_RX_PLACE_SIZE	1480
+/*
+ * The DMA writes a buffer from a bus width boundary, 8 bytes on a 64-bit
+ * AXI bus. The first buffer of a frame may start anywhere; it then holds
+ * that many fewer bytes. The frame is started up to 7 bytes into buffer
+ * 1, so that the payload which follows is aligned at the placed address.
+ */
+#define DW_RX_PLACE_ALIGN	8
+
 /*
  * txrx_status definitions
  */
@@ -217,14 +255,19 @@ struct dmamacdescr {
 #endif
 
 struct dw_eth_dev {
-	struct dmamacdescr tx_mac_descrtable[CONFIG_TX_DESCR_NUM];
-	struct dmamacdescr rx_mac_descrtable[CONFIG_RX_DESCR_NUM];
-	char txbuffs[TX_TOTAL_BUFSIZE] __aligned(ARCH_DMA_MINALIGN);
-	char rxbuffs[RX_TOTAL_BUFSIZE] __aligned(ARCH_DMA_MINALIGN);
+	struct dmamacdescr *tx_mac_descrtable;
+	struct dmamac_rxdescr *rx_mac_descrtable;
+	char *txbuffs;
+	char *rxbuffs;
 
 	u32 interface;
+	u32 tx_descrnum;
+	u32 rx_descrnum;
 	u32 tx_currdescnum;
 	u32 rx_currdescnum;
+#ifdef CONFIG_NET_RX_PLACE
+	uchar **rx_place;	/* placed payload address per Rx descriptor */
+#endif
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -82,6 +82,10 @@ static unsigned int ep_fifo_size =  512;
 static unsigned int ep_fifo_size2 = 1024;
 static int reset_available = 1;
 
+/* Transfer size and packet count limits of one DMA transfer, from GHWCFG3 */
+static unsigned int max_xfer_size;
+static unsigned int max_pkt_cnt;
+
 static struct usb_ctrlrequest *usb_ctrl;
 static dma_addr_t usb_ctrl_dma_addr;
 
@@ -407,6 +411,7 @@ static void reconfig_usbd(struct dwc2_udc *dev)
 	int i;
 	unsigned int uTemp = writel(CORE_SOFT_RESET, &reg->grstctl);
 	uint32_t dflt_gusbcfg;
+	uint32_t hwcfg3;
 
 	debug("Reseting OTG controller\n");
 
@@ -499,6 +504,11 @@ static void reconfig_usbd(struct dwc2_udc *dev)
 
 	/* 14. Initialize OTG Link Core.*/
 	writel(GAHBCFG_INIT, &reg->gahbcfg);
+
+	/* 15. Widths of the transfer size and packet counters */
+	hwcfg3 = readl(&reg->ghwcfg3);
+	max_xfer_size = (1 << XFER_SIZE_CNTR_WIDTH(hwcfg3)) - 1;
+	max_pkt_cnt = (1 << PKT_CNTR_WIDTH(hwcfg3)) - 1;
 }
 
 static void set_max_pktsize(struct dwc2_udc *dev, enum usb_device_speed speed)
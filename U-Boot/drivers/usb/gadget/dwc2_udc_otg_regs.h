@@ -61,7 +61,12 @@ struct dwc2_usbotg_reg {
 	u32 grxstsp; /* Receive Status Debug Pop/Status Pop */
 	u32 grxfsiz; /* Receive FIFO Size */
 	u32 gnptxfsiz; /* Non-Periodic Transmit FIFO Size */
-	u8  res1[216];
+	u8  res1[24];
+	u32 ghwcfg1; /* User Hardware Configuration1 */
+	u32 ghwcfg2; /* User Hardware Configuration2 */
+	u32 ghwcfg3; /* User Hardware Configuration3 */
+	u32 ghwcfg4; /* User Hardware Configuration4 */
+	u8  res1_1[176];
 	u32 dieptxf[15]; /* Device Periodic Transmit FIFO size register */
 	u8  res2[1728];
 	/* Device Configuration */
@@ -106,6 +111,10 @@ struct dwc2_usbotg_reg {
 #define AHB_MASTER_IDLE		(1u<<31)
 #define CORE_SOFT_RESET		(0x1<<0)
 
+/* DWC2_UDC_OTG_GHWCFG3 */
+#define XFER_SIZE_CNTR_WIDTH(x)		(((x) & 0xF) + 11)
+#define PKT_CNTR_WIDTH(x)		((((x) >> 4) & 0x7) + 4)
+
 /* DWC2_UDC_OTG_GINTSTS/DWC2_UDC_OTG_GINTMSK core interrupt register */
 #define INT_RESUME			(1u<<31)
 #define INT_DISCONN			(0x1<<29)
@@ -261,7 +270,7 @@ struct dwc2_usbotg_reg {
 #define DOEPT_SIZ_PKT_CNT(x)                      (x << 19)
 #define DOEPT_SIZ_XFER_SIZE(x)                    (x << 0)
 #define DOEPT_SIZ_XFER_SIZE_MAX_EP0               (0x7F << 0)
-#define DOEPT_SIZ_XFER_SIZE_MAX_EP                (0x7FFF << 0)
+#define DOEPT_SIZ_XFER_SIZE_MAX_EP                (0x7FFFF << 0)
 
 /* Device Endpoint-N Control Register (DIEPCTLn/DOEPCTLn) */
 #define DIEPCTL_TX_FIFO_NUM(x)                    (x << 22)
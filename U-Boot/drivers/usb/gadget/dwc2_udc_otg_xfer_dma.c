@@ -90,6 +90,14 @@ static inline void dwc2_ep0_complete_out(void)
 }
 
 
+/* The most one DMA transfer can move, in whole packets of the endpoint */
+static u32 dwc2_max_xfer(struct dwc2_ep *ep)
+{
+	u32 max = min_t(u32, max_xfer_size, max_pkt_cnt * ep->ep.maxpacket);
+
+	return max - max % ep->ep.maxpacket;
+}
+
 static int setdma_rx(struct dwc2_ep *ep, struct dwc2_request *req)
 {
 	u32 *buf, ctrl;
@@ -98,7 +106,7 @@ static int setdma_rx(struct dwc2_ep *ep, struct dwc2_request *req)
 
 	buf = req->req.buf + req->req.actual;
 	length = min_t(u32, req->req.length - req->req.actual,
-		       ep_num ? DMA_BUFFER_SIZE : ep->ep.maxpacket);
+		       ep_num ? dwc2_max_xfer(ep) : ep->ep.maxpacket);
 
 	ep->len = length;
 	ep->dma_buf = buf;
@@ -139,13 +147,18 @@ static int setdma_tx(struct dwc2_ep *ep, struct dwc2_request *req)
 
 	if (ep_num == EP0_CON)
 		length = min(length, (u32)ep_maxpacket(ep));
+	else
+		length = min(length, dwc2_max_xfer(ep));
 
 	ep->len = length;
 	ep->dma_buf = buf;
 
-	flush_dcache_range((unsigned long) ep->dma_buf,
-			   (unsigned long) ep->dma_buf +
-			   ROUND(ep->len, CONFIG_SYS_CACHELINE_SIZE));
+	/* the whole request is written back before its first transfer */
+	if (!req->req.actual)
+		flush_dcache_range((unsigned long)req->req.buf,
+				   (unsigned long)req->req.buf +
+				   ROUND(req->req.length,
+					 CONFIG_SYS_CACHELINE_SIZE));
 
 	if (length == 0)
 		pktcnt = 1;
@@ -223,13 +236,12 @@ static void complete_rx(struct dwc2_udc *dev, u8 ep_num)
 	 *
 	 * For armv7, the cache_v7.c provides proper code to emit "ERROR"
 	 * message to warn users.
+	 *
+	 * The request is invalidated once, when all of its data is in.
 	 */
-	invalidate_dcache_range((unsigned long) ep->dma_buf,
-				(unsigned long) ep->dma_buf +
-				ROUND(xfer_size, CONFIG_SYS_CACHELINE_SIZE));
-
 	req->req.actual += min(xfer_size, req->req.length - req->req.actual);
-	is_short = (xfer_size < ep->ep.maxpacket);
+	/* a transfer of several packets ends early on a short one */
+	is_short = (xfer_size < ep->len);
 
 	debug_cond(DEBUG_OUT_EP != 0,
 		   "%s: RX DMA done : ep = %d, rx bytes = %d/%d, "
@@ -238,6 +250,11 @@ static void complete_rx(struct dwc2_udc *dev, u8 ep_num)
 		   is_short, ep_tsr, xfer_size);
 
 	if (is_short || req->req.actual == req->req.length) {
+		invalidate_dcache_range((unsigned long)req->req.buf,
+					(unsigned long)req->req.buf +
+					ROUND(req->req.actual,
+					      CONFIG_SYS_CACHELINE_SIZE));
+
 		if (ep_num == EP0_CON && dev->ep0state == DATA_STATE_RECV) {
 			debug_cond(DEBUG_OUT_EP != 0, "	=> Send ZLP\n");
 			dwc2_udc_ep0_zlp(dev);
@@ -19,6 +19,7 @@
 #include <linux/usb/gadget.h>
 #include <linux/usb/composite.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 #include <version.h>
 #include <g_dnl.h>
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
@@ -166,6 +167,7 @@ static const char * const f_reserve_part[] = {
 static unsigned int div_download_bytes;
 static char *div_dl_part;
 static bool is_div_dl;
+static bool div_dl_dev_ready;	/* device selected for the divided download */
 
 /*
  * device partition functions
@@ -247,27 +249,31 @@ static int mmc_part_write(struct fastboot_part *fpart, void *buf,
 	debug("** mmc.%d partition %s (%s)**\n", dev, fpart->partition,
 	      fpart->fs_type&FASTBOOT_FS_EXT4 ? "FS" : "Image");
 
-	/* set mmc devicee */
-	if (0 > get_device("mmc", simple_itoa(dev), &desc)) {
-		if (0 > run_command(cmd, 0))
+	/* a divided download is written a piece at a time, select once */
+	if (!is_div_dl || !div_dl_dev_ready) {
+		/* set mmc devicee */
+		if (0 > get_device("mmc", simple_itoa(dev), &desc)) {
+			if (0 > run_command(cmd, 0))
+				return -1;
+			if (0 > run_command("mmc rescan", 0))
+				return -1;
+		}
+
+		if (0 > run_command(cmd, 0))	/* mmc device */
 			return -1;
-		if (0 > run_command("mmc rescan", 0))
+
+		if (0 > get_device("mmc", simple_itoa(dev), &desc))
 			return -1;
 	}
 
-	if (0 > run_command(cmd, 0))	/* mmc device */
-		return -1;
-
-	if (0 > get_device("mmc", simple_itoa(dev), &desc))
-		return -1;
-
 	if (is_div_dl) {
+		div_dl_dev_ready = true;
 		blk = fpart->start/blk_size;
 		cnt = (length/blk_size) + ((length & (blk_size-1)) ? 1 : 0);
 
-		printf("write image to 0x%llx(0x%x), 0x%llx(0x%x)\n",
-		       fpart->start, (unsigned int)blk, length,
-		       (unsigned int)cnt);
+		debug("write image to 0x%llx(0x%x), 0x%llx(0x%x)\n",
+		      fpart->start, (unsigned int)blk, length,
+		      (unsigned int)cnt);
 
 		ret = mmc_bwrite(dev, blk, cnt, buf);
 
@@ -1141,9 +1147,11 @@ static void fb_flash_write_based_partmap(const char *cmd,
 				    fd->write_part) {
 					if (0 > fd->write_part(fp,
 							       download_buffer,
-							       download_bytes))
+							       download_bytes)) {
 						sprintf(response,
 							"FAIL to flash");
+						continue;
+					}
 				}
 
 				fastboot_okay(response, "");
@@ -1165,12 +1173,29 @@ static void fb_flash_write_based_partmap(const char *cmd,
 
 #define EP_BUFFER_SIZE			4096
 
+/*
+ * The image is received with DL_REQ_NUM OUT requests of up to DL_REQ_SIZE
+ * each, queued together and pointing straight into the download buffer.
+ */
+#define DL_REQ_NUM			4
+#define DL_REQ_SIZE			SZ_1M
+
+/*
+ * A divided download alternates between two CONFIG_FASTBOOT_DIV_SIZE
+ * windows of the buffer when it has room for both: one fills from USB while
+ * fastboot_poll() writes the other out, DIV_FLASH_STEP bytes per call.
+ */
+#define DIV_DL_WINDOWS			\
+	(CONFIG_FASTBOOT_BUF_SIZE / CONFIG_FASTBOOT_DIV_SIZE >= 2 ? 2 : 1)
+#define DIV_FLASH_STEP			(DL_REQ_NUM * DL_REQ_SIZE)
+
 struct f_fastboot {
 	struct usb_function usb_function;
 
 	/* IN/OUT EP's and corresponding requests */
 	struct usb_ep *in_ep, *out_ep;
 	struct usb_request *in_req, *out_req;
+	struct usb_request *dl_req[DL_REQ_NUM];
 };
 
 static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
@@ -1182,6 +1207,14 @@ static struct f_fastboot *fastboot_func;
 static unsigned int fastboot_flash_session_id;
 static unsigned int download_size;
 static unsigned int download_bytes;
+static unsigned int download_queued;	/* bytes requests are queued for */
+static unsigned int download_window;	/* image offset of the window */
+static void *dl_window_buf;		/* where the window is received */
+static void *div_flash_buf;		/* window being written out */
+static unsigned int div_flash_size;
+static unsigned int div_flash_done;
+static bool div_flash_failed;
+static bool div_dl_stalled;		/* no window free to receive into */
 static bool is_high_speed;
 
 static struct usb_endpoint_descriptor fs_ep_in = {
@@ -1259,6 +1292,7 @@ static struct usb_gadget_strings *fastboot_strings[] = {
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
 static int strcmp_l1(const char *s1, const char *s2);
 
 
@@ -1330,6 +1364,7 @@ static void fastboot_unbind(struct usb_configuration *c, struct usb_function *f)
 static void fastboot_disable(struct usb_function *f)
 {
 	struct f_fastboot *f_fb = func_to_fastboot(f);
+	int i;
 
 	usb_ep_disable(f_fb->out_ep);
 	usb_ep_disable(f_fb->in_ep);
@@ -1339,6 +1374,17 @@ static void fastboot_disable(struct usb_function *f)
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
 		f_fb->out_req = NULL;
 	}
+	for (i = 0; i < DL_REQ_NUM; i++) {
+		if (f_fb->dl_req[i]) {
+			usb_ep_free_request(f_fb->out_ep, f_fb->dl_req[i]);
+			f_fb->dl_req[i] = NULL;
+		}
+	}
+	download_size = 0;
+	/* what is left of the window is not written out */
+	div_flash_size = 0;
+	div_flash_done = 0;
+	div_dl_stalled = false;
 	if (f_fb->in_req) {
 		free(f_fb->in_req->buf);
 		usb_ep_free_request(f_fb->in_ep, f_fb->in_req);
@@ -1368,7 +1414,7 @@ static struct usb_request *fastboot_start_ep(struct usb_ep *ep)
 static int fastboot_set_alt(struct usb_function *f,
 			    unsigned interface, unsigned alt)
 {
-	int ret;
+	int ret, i;
 	struct usb_composite_dev *cdev = f->config->cdev;
 	struct usb_gadget *gadget = cdev->gadget;
 	struct f_fastboot *f_fb = func_to_fastboot(f);
@@ -1397,6 +1443,16 @@ static int fastboot_set_alt(struct usb_function *f,
 	}
 	f_fb->out_req->complete = rx_handler_command;
 
+	for (i = 0; i < DL_REQ_NUM; i++) {
+		f_fb->dl_req[i] = usb_ep_alloc_request(f_fb->out_ep, 0);
+		if (!f_fb->dl_req[i]) {
+			puts("failed to alloc download req\n");
+			ret = -ENOMEM;
+			goto err;
+		}
+		f_fb->dl_req[i]->complete = rx_handler_dl_image;
+	}
+
 	/* make sure we don't enable the ep twice */
 	if (gadget->speed == USB_SPEED_HIGH) {
 		ret = usb_ep_enable(f_fb->in_ep, &hs_ep_in);
@@ -1608,35 +1664,140 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 	fastboot_tx_write_str(response);
 }
 
-static unsigned int rx_bytes_expected(unsigned int maxpacket)
+/*
+ * Queue 'req' for the next part of the image, at its place in the download
+ * buffer. A divided download fills a CONFIG_FASTBOOT_DIV_SIZE window of the
+ * buffer at a time. Return 0 if there was nothing to queue.
+ */
+static int rx_queue_dl(struct usb_ep *ep, struct usb_request *req)
 {
-	int rx_remain = download_size - download_bytes;
-	int rem = 0;
-	if (rx_remain < 0)
+	unsigned int offset = download_queued;
+	unsigned int len = download_size - download_queued;
+
+	if (is_div_dl) {
+		offset -= download_window;
+		len = min_t(unsigned int, len,
+			    CONFIG_FASTBOOT_DIV_SIZE - offset);
+	}
+	if (!len)
 		return 0;
-	if (rx_remain > EP_BUFFER_SIZE)
-		return EP_BUFFER_SIZE;
-	if (rx_remain < maxpacket) {
-		rx_remain = maxpacket;
-	} else if (rx_remain % maxpacket != 0) {
-		rem = rx_remain % maxpacket;
-		rx_remain = rx_remain - rem;
-	}
-	return rx_remain;
+	len = min_t(unsigned int, len, DL_REQ_SIZE);
+
+	req->buf = dl_window_buf + offset;
+	/* the last one ends with a short packet, but stays in the buffer */
+	req->length = min_t(unsigned int, ALIGN(len, ep->maxpacket),
+			    CONFIG_FASTBOOT_BUF_ADDR + CONFIG_FASTBOOT_BUF_SIZE -
+			    (unsigned long)req->buf);
+	req->actual = 0;
+	/* no dirty lines may be written back over the received data */
+	invalidate_dcache_range((unsigned long)req->buf,
+				(unsigned long)req->buf +
+				ALIGN(len, ARCH_DMA_MINALIGN));
+
+	if (usb_ep_queue(ep, req, 0))
+		return 0;
+	download_queued += len;
+
+	return 1;
+}
+
+static void rx_end_dl(struct usb_ep *ep, const char *response)
+{
+	struct usb_request *out_req = fastboot_func->out_req;
+	int i;
+
+	/*
+	 * Reset global transfer variable, keep download_bytes because
+	 * it will be used in the next possible flashing command
+	 */
+	download_size = 0;
+	div_dl_stalled = false;
+	for (i = 0; i < DL_REQ_NUM; i++)
+		usb_ep_dequeue(ep, fastboot_func->dl_req[i]);
+
+	*(char *)out_req->buf = '\0';
+	out_req->actual = 0;
+	usb_ep_queue(ep, out_req, 0);
+
+	fastboot_tx_write_str(response);
+}
+
+/*
+ * Hand a full window over to be written out and receive into the other one,
+ * or stall until fastboot_poll() has written out the window to receive into.
+ */
+static void rx_next_window(struct usb_ep *ep)
+{
+	int i;
+
+	if (div_download_bytes) {
+		if (div_flash_done < div_flash_size) {
+			div_dl_stalled = true;
+			return;
+		}
+		div_flash_buf = dl_window_buf;
+		div_flash_size = div_download_bytes;
+		div_flash_done = 0;
+		div_download_bytes = 0;
+		download_window = download_queued;
+		if (DIV_DL_WINDOWS > 1) {
+			dl_window_buf = (void *)CONFIG_FASTBOOT_BUF_ADDR;
+			if (div_flash_buf == dl_window_buf)
+				dl_window_buf += CONFIG_FASTBOOT_DIV_SIZE;
+		}
+	}
+
+	if (dl_window_buf == div_flash_buf && div_flash_done < div_flash_size) {
+		div_dl_stalled = true;
+		return;
+	}
+
+	div_dl_stalled = false;
+	for (i = 0; i < DL_REQ_NUM; i++)
+		rx_queue_dl(ep, fastboot_func->dl_req[i]);
+}
+
+static void div_flash_step(void)
+{
+	char response[FASTBOOT_RESPONSE_LEN] = "";
+	unsigned int len = min_t(unsigned int, div_flash_size - div_flash_done,
+				 DIV_FLASH_STEP);
+
+	fb_flash_write_based_partmap(div_dl_part, div_flash_buf + div_flash_done,
+				     len, response);
+	if (strncmp(response, "OKAY", 4))
+		div_flash_failed = true;
+	div_flash_done += len;
+}
+
+/* Write out the rest of the window handed over by rx_next_window() */
+static void div_flash_wait(void)
+{
+	while (div_flash_done < div_flash_size)
+		div_flash_step();
+}
+
+void fastboot_poll(void)
+{
+	if (div_flash_done >= div_flash_size)
+		return;
+
+	div_flash_step();
+
+	if (div_flash_done >= div_flash_size && div_dl_stalled)
+		rx_next_window(fastboot_func->out_ep);
 }
 
 #define BYTES_PER_DOT	0x20000
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
-	char response[FASTBOOT_RESPONSE_LEN];
 	unsigned int transfer_size = download_size - download_bytes;
-	const unsigned char *buffer = req->buf;
 	unsigned int buffer_size = req->actual;
 	unsigned int pre_dot_num, now_dot_num;
-	unsigned int max;
 
 	if (req->status != 0) {
-		printf("Bad status: %d\n", req->status);
+		if (download_size)
+			printf("Bad status: %d\n", req->status);
 		return;
 	}
 
@@ -1644,14 +1805,10 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		transfer_size = buffer_size;
 
 	if (!is_div_dl) {
-		memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + download_bytes,
-		       buffer, transfer_size);
 		pre_dot_num = download_bytes / BYTES_PER_DOT;
 		download_bytes += transfer_size;
 		now_dot_num = download_bytes / BYTES_PER_DOT;
 	} else {
-		memcpy((void *)CONFIG_FASTBOOT_BUF_ADDR + div_download_bytes,
-		       buffer, transfer_size);
 		pre_dot_num = div_download_bytes / BYTES_PER_DOT;
 		download_bytes += transfer_size;
 		div_download_bytes += transfer_size;
@@ -1666,49 +1823,46 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 
 	/* Check if transfer is done */
 	if (download_bytes >= download_size) {
-		/*
-		 * Reset global transfer variable, keep download_bytes because
-		 * it will be used in the next possible flashing command
-		 */
-		download_size = 0;
-		req->complete = rx_handler_command;
-		req->length = EP_BUFFER_SIZE;
+		rx_end_dl(ep, "OKAY");
+		printf("\ndownloading of %d bytes finished\n", download_bytes);
+		return;
+	}
 
-		sprintf(response, "OKAY");
-		fastboot_tx_write_str(response);
+	/* The requests queued behind this one would be at the wrong place */
+	if (req->actual < req->length) {
+		printf("\nshort transfer at %d of %d bytes\n", download_bytes,
+		       download_size);
+		rx_end_dl(ep, "FAILshort transfer");
+		return;
+	}
 
-		printf("\ndownloading of %d bytes finished\n", download_bytes);
-	} else {
-		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
-				fs_ep_out.wMaxPacketSize;
-		req->length = rx_bytes_expected(max);
-		if (req->length < ep->maxpacket)
-			req->length = ep->maxpacket;
-		if (is_div_dl &&
-		    (div_download_bytes >= CONFIG_FASTBOOT_DIV_SIZE)) {
-			fb_flash_write_based_partmap(div_dl_part,
-						     (void *)
-						     CONFIG_FASTBOOT_BUF_ADDR,
-						     div_download_bytes,
-						     response);
-			div_download_bytes = 0;
-		}
+	if (is_div_dl && div_download_bytes >= CONFIG_FASTBOOT_DIV_SIZE) {
+		/* the window is full and no request is queued */
+		rx_next_window(ep);
+		return;
 	}
 
-	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+	rx_queue_dl(ep, req);
 }
 
 static void cb_download(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
 	char response[FASTBOOT_RESPONSE_LEN];
-	unsigned int max;
+	int i;
+
+	/* the buffer is about to be overwritten */
+	div_flash_wait();
 
 	strsep(&cmd, ":");
 	download_size = simple_strtoul(cmd, NULL, 16);
 	download_bytes = 0;
+	download_queued = 0;
+	download_window = 0;
+	dl_window_buf = (void *)CONFIG_FASTBOOT_BUF_ADDR;
 	div_download_bytes = 0;
+	div_flash_failed = false;
+	div_dl_dev_ready = false;
 	is_div_dl = 0;
 
 	printf("Starting download of %d bytes\n", download_size);
@@ -1720,26 +1874,18 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 		if (div_dl_part) {
 			is_div_dl = 1;
 			sprintf(response, "DATA%08x", download_size);
-			req->complete = rx_handler_dl_image;
-			max = is_high_speed ? hs_ep_out.wMaxPacketSize :
-				fs_ep_out.wMaxPacketSize;
-			req->length = rx_bytes_expected(max);
-			if (req->length < ep->maxpacket)
-				req->length = ep->maxpacket;
-
 		} else {
 			download_size = 0;
 			sprintf(response, "FAILdata too large");
 		}
 	} else {
 		sprintf(response, "DATA%08x", download_size);
-		req->complete = rx_handler_dl_image;
-		max = is_high_speed ? hs_ep_out.wMaxPacketSize :
-			fs_ep_out.wMaxPacketSize;
-		req->length = rx_bytes_expected(max);
-		if (req->length < ep->maxpacket)
-			req->length = ep->maxpacket;
 	}
+
+	/* the download requests take the data, not the command request */
+	for (i = 0; download_size && i < DL_REQ_NUM; i++)
+		rx_queue_dl(ep, fastboot_func->dl_req[i]);
+
 	fastboot_tx_write_str(response);
 }
 
@@ -1831,10 +1977,12 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 	}
 
 	if (is_div_dl) {
-		fb_flash_write_based_partmap(div_dl_part,
-					     (void *)CONFIG_FASTBOOT_BUF_ADDR,
+		div_flash_wait();
+		sprintf(response, "FAIL partition does not exist");
+		fb_flash_write_based_partmap(div_dl_part, dl_window_buf,
 					     div_download_bytes, response);
-		fastboot_okay(response, "");
+		if (div_flash_failed)
+			sprintf(response, "FAIL to flash");
 		goto done_flash;
 	}
 
@@ -1990,5 +2138,7 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
 
 	*cmdbuf = '\0';
 	req->actual = 0;
-	usb_ep_queue(ep, req, 0);
+	/* a download queues its own requests, and this one when it ends */
+	if (!download_size)
+		usb_ep_queue(ep, req, 0);
 }
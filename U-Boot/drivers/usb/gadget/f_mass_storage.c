@@ -319,6 +319,18 @@ struct fsg_common {
 	struct fsg_buffhd	*next_buffhd_to_drain;
 	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
 
+	/*
+	 * FSG_BUFLEN of blocks read ahead past the end of the last read, and
+	 * the tail of the last write, written out during the next command.
+	 */
+	void			*ra_buf;
+	u32			ra_lba;
+	u32			ra_blocks;
+	u32			ra_next;	/* where to read ahead, or ~0 */
+	void			*wb_buf;
+	u32			wb_lba;
+	u32			wb_blocks;
+
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
 
@@ -698,6 +710,50 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Write out the blocks do_write() held back. A failure is reported by the
+ * command that flushes, the one the blocks came with has completed already.
+ */
+static int flush_write_behind(struct fsg_common *common)
+{
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+	u32		blocks = common->wb_blocks;
+
+	if (!blocks)
+		return 0;
+
+	common->wb_blocks = 0;
+	if (ums->write_sector(ums, common->wb_lba, blocks,
+			      common->wb_buf) != blocks) {
+		curlun->sense_data = SS_WRITE_ERROR;
+		curlun->info_valid = 1;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/* Read ahead the blocks following the last read, if any */
+static void read_ahead(struct fsg_common *common)
+{
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+	u32		lba = common->ra_next;
+	u32		blocks;
+	int		rc;
+
+	if (lba >= curlun->num_sectors)
+		return;
+
+	common->ra_next = ~0;
+	blocks = min_t(u32, curlun->num_sectors - lba,
+		       FSG_BUFLEN / SECTOR_SIZE);
+	rc = ums->read_sector(ums, lba, blocks, common->ra_buf);
+	if (rc > 0) {
+		common->ra_lba = lba;
+		common->ra_blocks = rc;
+	}
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = &common->luns[common->lun];
@@ -736,6 +792,9 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	if (flush_write_behind(common))
+		return -EINVAL;
+
 	for (;;) {
 
 		/* Figure out how much we need to read:
@@ -771,11 +830,18 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		/* Perform the read */
-		rc = ums->read_sector(ums,
-				      file_offset / SECTOR_SIZE,
-				      amount / SECTOR_SIZE,
-				      (char __user *)bh->buf);
+		/* Perform the read, from what was read ahead if possible */
+		lba = file_offset / SECTOR_SIZE;
+		if (common->ra_blocks && lba >= common->ra_lba &&
+		    lba + amount / SECTOR_SIZE <=
+		    common->ra_lba + common->ra_blocks) {
+			memcpy(bh->buf, common->ra_buf +
+			       (lba - common->ra_lba) * SECTOR_SIZE, amount);
+			rc = amount / SECTOR_SIZE;
+		} else {
+			rc = ums->read_sector(ums, lba, amount / SECTOR_SIZE,
+					      (char __user *)bh->buf);
+		}
 		if (!rc)
 			return -EIO;
 
@@ -807,8 +873,11 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		if (amount_left == 0)
+		if (amount_left == 0) {
+			/* while the host takes this, read the next blocks */
+			common->ra_next = file_offset / SECTOR_SIZE;
 			break;		/* No more left to read */
+		}
 
 		/* Send this buffer and go read some more */
 		bh->inreq->zero = 0;
@@ -864,6 +933,10 @@ static int do_write(struct fsg_common *common)
 		return -EINVAL;
 	}
 
+	/* What was read ahead may be about to change */
+	common->ra_blocks = 0;
+	common->ra_next = ~0;
+
 	/* Carry out the file writes */
 	get_some_more = 1;
 	file_offset = usb_offset = ((loff_t) lba) << 9;
@@ -945,11 +1018,26 @@ static int do_write(struct fsg_common *common)
 
 			amount = bh->outreq->actual;
 
-			/* Perform the write */
-			rc = ums->write_sector(ums,
-					       file_offset / SECTOR_SIZE,
-					       amount / SECTOR_SIZE,
-					       (char __user *)bh->buf);
+			/* Blocks held back from the last write go first */
+			if (flush_write_behind(common))
+				break;
+
+			/*
+			 * Perform the write, holding back the last part of
+			 * the command unless FUA asks for it on the medium
+			 */
+			if (amount == amount_left_to_write &&
+			    !(common->cmnd[1] & 0x08) && amount) {
+				memcpy(common->wb_buf, bh->buf, amount);
+				common->wb_lba = file_offset / SECTOR_SIZE;
+				common->wb_blocks = amount / SECTOR_SIZE;
+				rc = common->wb_blocks;
+			} else {
+				rc = ums->write_sector(ums,
+						       file_offset / SECTOR_SIZE,
+						       amount / SECTOR_SIZE,
+						       (char __user *)bh->buf);
+			}
 			if (!rc)
 				return -EIO;
 			nwritten = rc * SECTOR_SIZE;
@@ -989,6 +1077,13 @@ static int do_write(struct fsg_common *common)
 			continue;
 		}
 
+		/* Write out the last command's tail while data arrives */
+		if (common->wb_blocks) {
+			if (flush_write_behind(common))
+				break;
+			continue;
+		}
+
 		/* Wait for something to happen */
 		rc = sleep_thread(common);
 		if (rc)
@@ -1002,7 +1097,7 @@ static int do_write(struct fsg_common *common)
 
 static int do_synchronize_cache(struct fsg_common *common)
 {
-	return 0;
+	return flush_write_behind(common) ? -EINVAL : 0;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -1043,6 +1138,8 @@ static int do_verify(struct fsg_common *common)
 	file_offset = ((loff_t) lba) << 9;
 
 	/* Write out all the dirty buffers before invalidating them */
+	if (flush_write_behind(common))
+		return -EINVAL;
 
 	/* Just try to read the requested blocks */
 	while (amount_left > 0) {
@@ -1336,7 +1433,7 @@ static int do_start_stop(struct fsg_common *common)
 		return -EINVAL;
 	}
 
-	return 0;
+	return flush_write_behind(common) ? -EINVAL : 0;
 }
 
 static int do_prevent_allow(struct fsg_common *common)
@@ -1355,8 +1452,11 @@ static int do_prevent_allow(struct fsg_common *common)
 		return -EINVAL;
 	}
 
-	if (curlun->prevent_medium_removal && !prevent)
+	if (curlun->prevent_medium_removal && !prevent) {
 		fsg_lun_fsync_sub(curlun);
+		if (flush_write_behind(common))
+			return -EINVAL;
+	}
 	curlun->prevent_medium_removal = prevent;
 	return 0;
 }
@@ -1972,6 +2072,9 @@ static int do_scsi_command(struct fsg_common *common)
 		reply = check_command(common, 6, DATA_DIR_NONE,
 				0, 1,
 				"TEST UNIT READY");
+		/* the host polls with it, so nothing is held back for long */
+		if (reply == 0 && flush_write_behind(common))
+			reply = -EINVAL;
 		break;
 
 	/* Although optional, this command is used by MS-Windows.  We
@@ -2146,6 +2249,9 @@ static int get_next_command(struct fsg_common *common)
 	 * can reuse it for the next filling.  No need to advance
 	 * next_buffhd_to_fill. */
 
+	/* Read ahead while the end of the last reply and the CBW move */
+	read_ahead(common);
+
 	/* Wait for the CBW to arrive */
 	while (bh->state != BUF_STATE_FULL) {
 		rc = sleep_thread(common);
@@ -2414,15 +2520,19 @@ int fsg_main_thread(void *common_)
 
 		if (!common->running) {
 			ret = sleep_thread(common);
-			if (ret)
+			if (ret) {
+				flush_write_behind(common);
 				return ret;
+			}
 
 			continue;
 		}
 
 		ret = get_next_command(common);
-		if (ret)
+		if (ret) {
+			flush_write_behind(common);
 			return ret;
+		}
 
 		if (!exception_in_progress(common))
 			common->state = FSG_STATE_DATA_PHASE;
@@ -2526,6 +2636,14 @@ buffhds_first_it:
 	} while (--i);
 	bh->next = common->buffhds;
 
+	common->ra_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, FSG_BUFLEN);
+	common->wb_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, FSG_BUFLEN);
+	if (unlikely(!common->ra_buf || !common->wb_buf)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
+	common->ra_next = ~0;
+
 	snprintf(common->inquiry_string, sizeof common->inquiry_string,
 		 "%-8s%-16s%04x",
 		 "Linux   ",
@@ -2591,6 +2709,8 @@ static void fsg_common_release(struct kref *ref)
 			kfree(bh->buf);
 		} while (++bh, --i);
 	}
+	kfree(common->ra_buf);
+	kfree(common->wb_buf);
 
 	if (common->free_storage_on_release)
 		kfree(common);
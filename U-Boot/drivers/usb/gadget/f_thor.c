@@ -141,6 +141,60 @@ static int process_rqt_cmd(const struct rqt_box *rqt)
 	return true;
 }
 
+/*
+ * The DFU buffer is split in two halves: while one of them is filled from
+ * USB, the other is written to the medium a THOR_STORE_STEP at a time,
+ * from thor_rx_data() whenever it waits for a packet.
+ */
+static void *thor_store_buf;
+static long long int thor_store_size, thor_store_done;
+static int thor_store_err;
+/* Half of the buffer holding the data not yet handed to thor_store_buf */
+static void *thor_tail_buf;
+
+static void thor_store_start(void *buf, long long int size)
+{
+	thor_store_buf = buf;
+	thor_store_size = size;
+	thor_store_done = 0;
+}
+
+static void thor_store_step(void)
+{
+	struct dfu_entity *dfu_entity;
+	long long int len;
+	int ret;
+
+	len = thor_store_size - thor_store_done;
+	if (len <= 0 || thor_store_err)
+		return;
+	if (len > THOR_STORE_STEP)
+		len = THOR_STORE_STEP;
+
+	dfu_entity = dfu_get_entity(alt_setting_num);
+	ret = dfu_write_direct(dfu_entity, thor_store_buf + thor_store_done,
+			       len);
+	if (ret) {
+		error("DFU write failed [%d] offset: %llu", ret,
+		      thor_store_done);
+		thor_store_err = ret;
+		return;
+	}
+
+	thor_store_done += len;
+	if (thor_store_done == thor_store_size)
+		puts("#");
+}
+
+/* Finish writing the half handed over last */
+static int thor_store_wait(void)
+{
+	while (!thor_store_err && thor_store_done < thor_store_size)
+		thor_store_step();
+
+	return thor_store_err;
+}
+
 static long long int download_head(unsigned long long total,
 				   unsigned int packet_size,
 				   long long int *left,
@@ -149,15 +203,29 @@ static long long int download_head(unsigned long long total,
 	long long int rcv_cnt = 0, left_to_rcv, ret_rcv;
 	struct dfu_entity *dfu_entity = dfu_get_entity(alt_setting_num);
 	void *transfer_buffer = dfu_get_buf(dfu_entity);
+	unsigned long unit = dfu_get_buf_size() / 2;
+	void *half = transfer_buffer;
 	void *buf = transfer_buffer;
 	int usb_pkt_cnt = 0, ret;
 
+	thor_store_start(NULL, 0);
+	thor_store_err = 0;
+
+	if (!transfer_buffer) {
+		error("Transfer buffer not allocated!");
+		return -ENXIO;
+	}
+
+	unit -= unit % packet_size;
+	if (!unit) {
+		error("DFU buffer too small: 0x%lx", dfu_get_buf_size());
+		return -ENOMEM;
+	}
+
 	/*
-	 * Files smaller than THOR_STORE_UNIT_SIZE (now 32 MiB) are stored on
-	 * the medium.
-	 * The packet response is sent on the purpose after successful data
-	 * chunk write. There is a room for improvement when asynchronous write
-	 * is performed.
+	 * A packet is acknowledged as soon as it is received; the data reach
+	 * the medium while the following ones arrive. Only when both halves
+	 * are full does the response wait for the older one to be written.
 	 */
 	while (total - rcv_cnt >= packet_size) {
 		thor_set_dma(buf, packet_size);
@@ -169,16 +237,15 @@ static long long int download_head(unsigned long long total,
 		debug("%d: RCV data count: %llu cnt: %d\n", usb_pkt_cnt,
 		      rcv_cnt, *cnt);
 
-		if ((rcv_cnt % THOR_STORE_UNIT_SIZE) == 0) {
-			ret = dfu_write(dfu_get_entity(alt_setting_num),
-					transfer_buffer, THOR_STORE_UNIT_SIZE,
-					(*cnt)++);
-			if (ret) {
-				error("DFU write failed [%d] cnt: %d",
-				      ret, *cnt);
+		if (buf == half + unit) {
+			ret = thor_store_wait();
+			if (ret)
 				return ret;
-			}
-			buf = transfer_buffer;
+			thor_store_start(half, unit);
+
+			half = half == transfer_buffer ?
+				transfer_buffer + unit : transfer_buffer;
+			buf = half;
 		}
 		send_data_rsp(0, ++usb_pkt_cnt);
 	}
@@ -187,10 +254,11 @@ static long long int download_head(unsigned long long total,
 	left_to_rcv = total - rcv_cnt;
 
 	/*
-	 * Calculate number of data already received. but not yet stored
-	 * on the medium (they are smaller than THOR_STORE_UNIT_SIZE)
+	 * Calculate number of data already received, but not yet handed
+	 * over to be stored on the medium (they are smaller than a half)
 	 */
-	*left = left_to_rcv + buf - transfer_buffer;
+	*left = left_to_rcv + buf - half;
+	thor_tail_buf = half;
 	debug("%s: left: %llu left_to_rcv: %llu buf: 0x%p\n", __func__,
 	      *left, left_to_rcv, buf);
 
@@ -228,8 +296,13 @@ static int download_tail(long long int left, int cnt)
 		return -ENXIO;
 	}
 
+	ret = thor_store_wait();
+	thor_store_start(NULL, 0);
+	if (ret)
+		return ret;
+
 	if (left) {
-		ret = dfu_write(dfu_entity, transfer_buffer, left, cnt++);
+		ret = dfu_write_direct(dfu_entity, thor_tail_buf, left);
 		if (ret) {
 			error("DFU write failed [%d]: left: %llu", ret, left);
 			return ret;
@@ -551,6 +624,7 @@ static int thor_rx_data(void)
 			usb_gadget_handle_interrupts(0);
 			if (ctrlc())
 				return -1;
+			thor_store_step();
 		}
 		dev->rxdata = 0;
 		data_to_rx -= dev->out_req->actual;
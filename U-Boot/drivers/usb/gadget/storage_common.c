@@ -305,11 +305,11 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
-/* Number of buffers we will use.  2 is enough for double-buffering */
-#define FSG_NUM_BUFFERS	2
+/* Number of buffers we will use, so that more than one transfer is queued */
+#define FSG_NUM_BUFFERS	4
 
-/* Default size of buffer length. */
-#define FSG_BUFLEN	((u32)16384)
+/* Default size of buffer length, large enough for efficient block I/O */
+#define FSG_BUFLEN	((u32)65536)
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
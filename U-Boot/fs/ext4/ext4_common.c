@@ -1410,43 +1410,141 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
-static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
-		uint32_t fileblock, int log2_blksz)
+/*
+ * Extent tree nodes read from the disk, one per level below the inode.
+ * Reading a file run by run looks up the same nodes over and over, so
+ * only the first lookup through a node reads it.
+ */
+#define EXT4_EXT_MAX_DEPTH	5
+
+static struct {
+	char *buf;
+	unsigned long long blkno;
+} ext4fs_ext_node[EXT4_EXT_MAX_DEPTH];
+static int ext4fs_ext_node_size;
+
+static void ext4fs_ext_node_reset(void)
 {
-	struct ext4_extent_idx *index;
-	unsigned long long block;
-	int blksz = EXT2_BLOCK_SIZE(data);
 	int i;
 
-	while (1) {
-		index = (struct ext4_extent_idx *)(ext_block + 1);
+	for (i = 0; i < EXT4_EXT_MAX_DEPTH; i++) {
+		free(ext4fs_ext_node[i].buf);
+		ext4fs_ext_node[i].buf = NULL;
+		ext4fs_ext_node[i].blkno = 0;
+	}
+	ext4fs_ext_node_size = 0;
+}
 
-		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
-			return 0;
+static struct ext4_extent_header *ext4fs_get_extent_node(int level,
+						unsigned long long block)
+{
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
 
+	if (blksz != ext4fs_ext_node_size) {
+		ext4fs_ext_node_reset();
+		ext4fs_ext_node_size = blksz;
+	}
+	if (!ext4fs_ext_node[level].buf) {
+		ext4fs_ext_node[level].buf = memalign(ARCH_DMA_MINALIGN, blksz);
+		if (!ext4fs_ext_node[level].buf)
+			return NULL;
+	} else if (ext4fs_ext_node[level].blkno == block) {
+		return (struct ext4_extent_header *)ext4fs_ext_node[level].buf;
+	}
+
+	/* Block 0 is never a node, so it marks an empty slot */
+	ext4fs_ext_node[level].blkno = 0;
+	if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+			    ext4fs_ext_node[level].buf))
+		return NULL;
+	ext4fs_ext_node[level].blkno = block;
+
+	return (struct ext4_extent_header *)ext4fs_ext_node[level].buf;
+}
+
+/* Number of entries in @first[0..@entries) that start at or before @key */
+#define EXT4_EXT_BSEARCH(first, entries, field, key) ({		\
+	int __lo = 0, __hi = (entries), __mid;				\
+	while (__lo < __hi) {						\
+		__mid = (__lo + __hi) / 2;				\
+		if (le32_to_cpu((first)[__mid].field) <= (key))		\
+			__lo = __mid + 1;				\
+		else							\
+			__hi = __mid;					\
+	}								\
+	__lo;								\
+})
+
+long int ext4fs_extent_run(struct ext2_inode *inode, uint32_t fileblock,
+			   uint32_t *run)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	unsigned long long block;
+	uint32_t start, len, end = ~0;
+	int level, entries, i, uninit;
+
+	ext_block = (struct ext4_extent_header *)inode->b.blocks.dir_blocks;
+	for (level = 0; ; level++) {
+		if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC)
+			goto invalid;
+		entries = le16_to_cpu(ext_block->eh_entries);
 		if (ext_block->eh_depth == 0)
-			return ext_block;
-		i = -1;
-		do {
-			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
-				break;
-		} while (fileblock >= le32_to_cpu(index[i].ei_block));
+			break;
+		if (!entries || level >= EXT4_EXT_MAX_DEPTH)
+			goto invalid;
 
-		if (--i < 0)
+		index = (struct ext4_extent_idx *)(ext_block + 1);
+		i = EXT4_EXT_BSEARCH(index, entries, ei_block, fileblock);
+		if (!i) {
+			/* Sparse file, before the first index */
+			*run = le32_to_cpu(index[0].ei_block) - fileblock;
 			return 0;
+		}
+		if (i < entries)
+			end = le32_to_cpu(index[i].ei_block);
+
+		block = le16_to_cpu(index[i - 1].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i - 1].ei_leaf_lo);
+		ext_block = ext4fs_get_extent_node(level, block);
+		if (!ext_block)
+			goto invalid;
+	}
 
-		block = le16_to_cpu(index[i].ei_leaf_hi);
-		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+	extent = (struct ext4_extent *)(ext_block + 1);
+	i = EXT4_EXT_BSEARCH(extent, entries, ee_block, fileblock);
+	if (i) {
+		start = le32_to_cpu(extent[i - 1].ee_block);
+		len = le16_to_cpu(extent[i - 1].ee_len);
+		uninit = len > EXT_INIT_MAX_LEN;
+		if (uninit)
+			len -= EXT_INIT_MAX_LEN;
+
+		if (fileblock - start < len) {
+			*run = start + len - fileblock;
+			/* Allocated but never written, reads as zeroes */
+			if (uninit)
+				return 0;
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
-		else
-			return 0;
+			block = le16_to_cpu(extent[i - 1].ee_start_hi);
+			block = (block << 32) +
+				le32_to_cpu(extent[i - 1].ee_start_lo);
+			return block + fileblock - start;
+		}
 	}
+
+	/* Sparse file, up to the next extent */
+	if (i < entries)
+		end = le32_to_cpu(extent[i].ee_block);
+	*run = end - fileblock;
+	return 0;
+
+invalid:
+	printf("invalid extent block\n");
+	return -EINVAL;
 }
 
 static int ext4fs_blockgroup
@@ -1511,53 +1609,16 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
+
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
+		uint32_t run;
 
-		free(buf);
-		return 0;
+		return ext4fs_extent_run(inode, fileblock, &run);
 	}
 
 	/* Direct blocks. */
@@ -1859,6 +1920,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_ext_node_reset();
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -2191,7 +2253,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* the file of a previous read left open by fs_hold() */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -40,6 +40,38 @@ static void downcase(char *str)
 static block_dev_desc_t *cur_dev;
 static disk_partition_t cur_part_info;
 
+/*
+ * Cache for reading files: a large window of the FAT, and the cluster chain
+ * of the file read last as runs of consecutive clusters. Nothing tells us
+ * when the device is written behind our back, so both are dropped whenever
+ * a device is set, and before every write.
+ */
+#define FATCACHEBLOCKS	384	/* a multiple of 3 for FAT12 */
+
+struct fat_run {
+	__u32 index;	/* number of the first cluster in the file */
+	__u32 clust;	/* first cluster */
+	__u32 count;	/* number of consecutive clusters */
+};
+
+static struct {
+	__u8 *fatbuf;		/* FATCACHEBLOCKS sectors of the FAT */
+	int fatbufnum;
+	__u32 start;		/* first cluster of the mapped file */
+	__u32 next;		/* cluster after the last run */
+	int end;		/* the chain is mapped to its end */
+	struct fat_run *runs;
+	int nr_runs;
+	int max_runs;
+} fat_cache;
+
+static void fat_cache_drop(void)
+{
+	free(fat_cache.fatbuf);
+	free(fat_cache.runs);
+	memset(&fat_cache, 0, sizeof(fat_cache));
+}
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -51,8 +83,7 @@ static int disk_read(__u32 block, __u32 nr_blocks, void *buf)
 	if (!cur_dev || !cur_dev->block_read)
 		return -1;
 
-	ret = cur_dev->block_read(cur_dev->dev,
-				  cur_part_info.start + block, nr_blocks, buf);
+	ret = blk_dread(cur_dev, cur_part_info.start + block, nr_blocks, buf);
 
 	if (nr_blocks && ret == 0)
 		return -1;
@@ -64,6 +95,7 @@ int fat_set_blk_dev(block_dev_desc_t *dev_desc, disk_partition_t *info)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, buffer, dev_desc->blksz);
 
+	fat_cache_drop();
 	cur_dev = dev_desc;
 	cur_part_info = *info;
 
@@ -163,11 +195,15 @@ static void get_name(dir_entry *dirent, char *s_name)
 }
 
 /*
- * Get the entry at index 'entry' in a FAT (12/16/32) table.
+ * Get the entry at index 'entry' in a FAT (12/16/32) table, through a
+ * window of 'blocks' FAT sectors at 'fatbuf', of which number '*fatbufnum'
+ * is loaded. 'blocks' must be a multiple of 3 for FAT12.
  * On failure 0x00 is returned.
  */
-static __u32 get_fatent(fsdata *mydata, __u32 entry)
+static __u32 get_fatent_window(fsdata *mydata, __u32 entry, __u8 *fatbuf,
+			       int *fatbufnum, __u32 blocks)
 {
+	__u32 bufsize = blocks * mydata->sect_size;
 	__u32 bufnum;
 	__u32 off16, offset;
 	__u32 ret = 0x00;
@@ -175,16 +211,16 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 
 	switch (mydata->fatsize) {
 	case 32:
-		bufnum = entry / FAT32BUFSIZE;
-		offset = entry - bufnum * FAT32BUFSIZE;
+		bufnum = entry / (bufsize / 4);
+		offset = entry - bufnum * (bufsize / 4);
 		break;
 	case 16:
-		bufnum = entry / FAT16BUFSIZE;
-		offset = entry - bufnum * FAT16BUFSIZE;
+		bufnum = entry / (bufsize / 2);
+		offset = entry - bufnum * (bufsize / 2);
 		break;
 	case 12:
-		bufnum = entry / FAT12BUFSIZE;
-		offset = entry - bufnum * FAT12BUFSIZE;
+		bufnum = entry / (bufsize * 2 / 3);
+		offset = entry - bufnum * (bufsize * 2 / 3);
 		break;
 
 	default:
@@ -196,11 +232,11 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	       mydata->fatsize, entry, entry, offset, offset);
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
+	if (bufnum != *fatbufnum) {
+		__u32 getsize = blocks;
+		__u8 *bufptr = fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * blocks;
 
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
@@ -211,41 +247,41 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 			debug("Error reading FAT blocks\n");
 			return ret;
 		}
-		mydata->fatbufnum = bufnum;
+		*fatbufnum = bufnum;
 	}
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *) fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *) fatbuf)[offset]);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
 
 		switch (offset & 0x3) {
 		case 0:
-			ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *) fatbuf)[off16]);
 			ret &= 0xfff;
 			break;
 		case 1:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xf000;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x00ff;
 			ret = (val2 << 4) | (val1 >> 12);
 			break;
 		case 2:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xff00;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x000f;
 			ret = (val2 << 8) | (val1 >> 8);
 			break;
 		case 3:
-			ret = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			ret = (ret & 0xfff0) >> 4;
 			break;
 		default:
@@ -259,6 +295,12 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+static __u32 get_fatent(fsdata *mydata, __u32 entry)
+{
+	return get_fatent_window(mydata, entry, mydata->fatbuf,
+				 &mydata->fatbufnum, FATBUFBLOCKS);
+}
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -322,9 +364,96 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Map the cluster chain starting at 'start' far enough to hold cluster
+ * number 'idx' of the file, and the run it is in up to cluster number 'last'
+ * at most. Return the run, or NULL if the chain is shorter or on errors.
+ */
+static struct fat_run *get_run(fsdata *mydata, __u32 start, __u32 idx,
+			       __u32 last)
+{
+	struct fat_run *run, *runs;
+	__u32 clust, index;
+	int lo, hi, mid;
+
+	if (!fat_cache.fatbuf) {
+		fat_cache.fatbuf = memalign(ARCH_DMA_MINALIGN,
+					    FATCACHEBLOCKS * mydata->sect_size);
+		if (!fat_cache.fatbuf) {
+			debug("Error: allocating memory\n");
+			return NULL;
+		}
+		fat_cache.fatbufnum = -1;
+	}
+
+	if (!fat_cache.nr_runs || fat_cache.start != start) {
+		fat_cache.start = start;
+		fat_cache.next = start;
+		fat_cache.end = 0;
+		fat_cache.nr_runs = 0;
+	}
+
+	run = fat_cache.nr_runs ? &fat_cache.runs[fat_cache.nr_runs - 1] : NULL;
+	while (!fat_cache.end &&
+	       (!run || run->index + run->count <= idx ||
+		(run->index + run->count <= last &&
+		 fat_cache.next == run->clust + run->count))) {
+		clust = fat_cache.next;
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			fat_cache.end = 1;
+			break;
+		}
+
+		if (run && clust == run->clust + run->count) {
+			run->count++;
+		} else {
+			/* before realloc() can move what run points to */
+			index = run ? run->index + run->count : 0;
+			if (fat_cache.nr_runs == fat_cache.max_runs) {
+				hi = fat_cache.max_runs ? 2 * fat_cache.max_runs
+							: 16;
+				runs = realloc(fat_cache.runs,
+					       hi * sizeof(*runs));
+				if (!runs) {
+					debug("Error: allocating memory\n");
+					return NULL;
+				}
+				fat_cache.runs = runs;
+				fat_cache.max_runs = hi;
+			}
+			mid = fat_cache.nr_runs++;
+			run = &fat_cache.runs[mid];
+			run->index = index;
+			run->clust = clust;
+			run->count = 1;
+		}
+
+		fat_cache.next = get_fatent_window(mydata, clust,
+						   fat_cache.fatbuf,
+						   &fat_cache.fatbufnum,
+						   FATCACHEBLOCKS);
+	}
+
+	lo = 0;
+	hi = fat_cache.nr_runs;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		run = &fat_cache.runs[mid];
+		if (idx < run->index)
+			hi = mid;
+		else if (idx - run->index >= run->count)
+			lo = mid + 1;
+		else
+			return run;
+	}
+
+	return NULL;
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
- * into 'buffer'.
+ * into 'buffer'. Runs of consecutive clusters are read in one go.
  * Update the number of bytes read in *gotsize or return -1 on fatal errors.
  */
 __u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
@@ -335,8 +464,8 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	struct fat_run *run;
+	__u32 idx, offset, clust, last;
 	loff_t actsize;
 
 	*gotsize = 0;
@@ -352,92 +481,52 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize += bytesperclust;
-	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
+	/* pos < filesize, which fits in 32 bits */
+	idx = (__u32)pos / bytesperclust;
+	offset = (__u32)pos % bytesperclust;
+	last = (__u32)(filesize - 1) / bytesperclust;
+	filesize -= pos;
 
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		actsize = min(filesize, (loff_t)bytesperclust);
-		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				(int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, get_contents_vfatname_block + pos, actsize);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
+	while (filesize) {
+		run = get_run(mydata, START(dentptr), idx, last);
+		if (!run) {
 			debug("Invalid FAT entry\n");
 			return 0;
 		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return 0;
+		clust = run->clust + (idx - run->index);
+
+		/* the cluster at pos, if pos is not at its beginning */
+		if (offset) {
+			actsize = min(filesize + offset, (loff_t)bytesperclust);
+			if (get_cluster(mydata, clust,
+					get_contents_vfatname_block,
+					(int)actsize) != 0) {
+				printf("Error reading cluster\n");
+				return -1;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
+			actsize -= offset;
+			memcpy(buffer, get_contents_vfatname_block + offset,
+			       actsize);
+			offset = 0;
+			idx++;
+		} else {
+			actsize = (loff_t)(run->count - (idx - run->index)) *
+				  bytesperclust;
+			actsize = min(filesize, actsize);
+			if (get_cluster(mydata, clust, buffer,
+					(unsigned long)actsize) != 0) {
+				printf("Error reading cluster\n");
+				return -1;
+			}
+			idx = run->index + run->count;
 		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return 0;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return 0;
 }
 
 /*
@@ -976,6 +976,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 
 	*actwrite = size;
 	dir_curclust = 0;
+	fat_cache_drop();
 
 	if (read_bootsectandvi(&bs, &volinfo, &mydata->fatsize)) {
 		debug("error: reading boot sector\n");
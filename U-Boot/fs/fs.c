@@ -254,6 +254,20 @@ static void fs_close(void)
 	fs_type = FS_TYPE_ANY;
 }
 
+/* Set by fs_hold(): fs_read() leaves the partition set */
+static int fs_held;
+
+void fs_hold(void)
+{
+	fs_held = 1;
+}
+
+void fs_release(void)
+{
+	fs_held = 0;
+	fs_close();
+}
+
 int fs_uuid(char *uuid_str)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
@@ -319,7 +333,8 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	/* If we requested a specific number of bytes, check we got it */
 	if (ret == 0 && len && *actread != len)
 		printf("** %s shorter than offset + len **\n", filename);
-	fs_close();
+	if (!fs_held)
+		fs_close();
 
 	return ret;
 }
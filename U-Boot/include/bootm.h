@@ -73,4 +73,34 @@ int bootm_decomp_image(int comp, ulong load, ulong image_start, int type,
 		       void *load_buf, void *image_buf, ulong image_len,
 		       uint unc_len, ulong *load_end);
 
+/**
+ * bootm_decomp_stream() - decompress an image while it is being read
+ *
+ * The image is read in blocks into a ring of two buffers. While one block
+ * is read, the one before it is decompressed to @load_buf on a secondary
+ * core, so reading and decompression overlap and the compressed image is
+ * never held whole in memory. An uncompressed image is read straight to
+ * @load_buf. Nothing is printed unless there is an error.
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load:	Destination load address in U-Boot memory
+ * @load_buf:	Place to decompress to
+ * @image_len:	Number of bytes of the image to read
+ * @unc_len:	Available space for decompression
+ * @read:	Reads the next @len bytes of the image to @buf, returns 0
+ *		or -ve on error
+ * @work:	Called with each block beside its decompression, e.g. to hash
+ *		it, or NULL. Runs as a cpu_work job: it must not print or
+ *		call into drivers
+ * @priv:	Passed to @read and @work
+ * @load_end:	Returns the end of the decompressed data
+ * @return 0 if OK, BOOTM_ERR_UNIMPLEMENTED if @comp cannot be decompressed
+ * this way (nothing has been read then), other -ve on error
+ */
+int bootm_decomp_stream(int comp, ulong load, void *load_buf, ulong image_len,
+			uint unc_len,
+			int (*read)(void *priv, void *buf, ulong len),
+			void (*work)(void *priv, const void *buf, ulong len),
+			void *priv, ulong *load_end);
+
 #endif
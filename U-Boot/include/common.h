@@ -784,6 +784,15 @@ ulong	ticks2usec    (unsigned long ticks);
 int	init_timebase (void);
 
 /* lib/gunzip.c */
+/**
+ * gzip_parse_header() - skip the header of gzip data
+ *
+ * @src:	gzip data
+ * @len:	Number of bytes available at @src
+ * @return offset of the deflate stream in @src, or -1 if the header is
+ * bad or does not fit in @len bytes
+ */
+int gzip_parse_header(const unsigned char *src, unsigned long len);
 int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
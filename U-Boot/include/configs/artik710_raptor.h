@@ -43,6 +43,14 @@
 #define COUNTER_FREQUENCY			200000000
 #define CPU_RELEASE_ADDR			CONFIG_SYS_INIT_SP_ADDR
 
+/* decompress on all cores, the parked ones reserved in the OS's fdt */
+#define CONFIG_CPU_WORK
+#define CONFIG_OF_SYSTEM_SETUP
+
+/* AArch64 memcpy(), memmove() and memset() */
+#define CONFIG_USE_ARCH_MEMCPY
+#define CONFIG_USE_ARCH_MEMSET
+
 /*-----------------------------------------------------------------------
  *  High Level System Configuration
  */
@@ -104,6 +112,7 @@
  */
 /* refer to common/env_common.c	*/
 #define CONFIG_BOOTDELAY			3
+#define CONFIG_ENV_DEFAULT_HASH
 
 /*-----------------------------------------------------------------------
  * Miscellaneous configurable options
@@ -189,6 +198,7 @@
 #define	CONFIG_ENV_OFFSET		(CONFIG_FIP_OFFSET +\
 					 CONFIG_FIP_SIZE)
 #define CONFIG_ENV_SIZE			(16*1024)	/* env size */
+#define CONFIG_ENV_MMC_LOG_SIZE		(16*1024)	/* after the env */
 #endif
 
 #if defined(CONFIG_MMC)
@@ -201,6 +211,8 @@
 #define CONFIG_CMD_EXT4_WRITE
 #define CONFIG_FS_EXT4
 #define CONFIG_EXT4_WRITE
+
+#define CONFIG_CMD_FITLOAD
 #endif
 
 /*-----------------------------------------------------------------------
@@ -312,6 +324,8 @@
 
 /* NET */
 #define CONFIG_CMD_GEN_ETHADDR
+#define CONFIG_TFTP_TSIZE
+#define CONFIG_NET_RX_PLACE
 
 /* FACTORY_INFO */
 /* tjt gets rid of this 9-15-2018
@@ -78,6 +78,7 @@
 
 #define CONFIG_ENV_SIZE		8192
 #define CONFIG_ENV_IS_NOWHERE
+#define CONFIG_ENV_DEFAULT_HASH
 
 /* SPI - enable all SPI flash types for testing purposes */
 #define CONFIG_CMD_SF
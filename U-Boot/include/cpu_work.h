@@ -0,0 +1,87 @@
+/*
+ * Running work on the secondary cores
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __CPU_WORK_H
+#define __CPU_WORK_H
+
+/*
+ * A job is a function that every core calls with the same argument; the
+ * cores share out the work themselves, typically by taking the next item
+ * from a counter in the argument with an atomic increment, so that a core
+ * which does not call it leaves nothing undone. A job must not print or
+ * call into drivers, only compute on memory.
+ */
+typedef void (*cpu_work_fn)(void *arg);
+
+#ifdef CONFIG_CPU_WORK
+/**
+ * cpu_work_run() - Run a job on all cores and wait for it
+ *
+ * The secondary cores are woken on first use. If that is not possible,
+ * the job only runs on the calling core. A core that does not take its
+ * part in time is left out, and one that takes it but does not finish in
+ * time is given up on; neither is used again.
+ *
+ * @fn:		Job
+ * @arg:	Argument passed to @fn on each core
+ * @return number of cores that ran the job, or -ETIMEDOUT if a core did
+ *	   not finish its part, which the caller must then do itself
+ */
+int cpu_work_run(cpu_work_fn fn, void *arg);
+
+/**
+ * cpu_work_start() - Start a job on one secondary core and return
+ *
+ * For a job that runs beside the caller, such as hashing a buffer while
+ * it is written out. Only one such job runs at a time; starting another,
+ * or cpu_work_run(), first waits for it. Without a secondary core the job
+ * runs on the calling core before this returns, and so does a job that
+ * the secondary core does not take in time, in cpu_work_finish().
+ *
+ * @fn:		Job
+ * @arg:	Argument passed to @fn
+ */
+void cpu_work_start(cpu_work_fn fn, void *arg);
+
+/**
+ * cpu_work_finish() - Wait for the job of cpu_work_start(), if any
+ *
+ * @return 0 if it is done, or -ETIMEDOUT if the core that took it did not
+ *	   finish it in time: what the job was working on is then undefined
+ */
+int cpu_work_finish(void);
+
+/**
+ * cpu_work_park() - Put the secondary cores back to sleep
+ *
+ * Done before the OS is started: the cores leave U-Boot with their caches
+ * cleaned and wait for the OS to release them, as they did in bl1, in a
+ * loop that is reserved in the device tree of the OS.
+ */
+void cpu_work_park(void);
+#else
+static inline int cpu_work_run(cpu_work_fn fn, void *arg)
+{
+	fn(arg);
+	return 1;
+}
+
+static inline void cpu_work_start(cpu_work_fn fn, void *arg)
+{
+	fn(arg);
+}
+
+static inline int cpu_work_finish(void)
+{
+	return 0;
+}
+
+static inline void cpu_work_park(void)
+{
+}
+#endif
+
+#endif /* __CPU_WORK_H */
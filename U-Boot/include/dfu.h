@@ -126,7 +126,7 @@ struct dfu_entity {
 	struct list_head list;
 
 	/* on the fly state */
-	u32 crc;
+	void *hash_ctx;		/* from dfu_hash_algo->hash_init() */
 	u64 offset;
 	int i_blk_seq_num;
 	u8 *i_buf;
@@ -162,6 +162,7 @@ bool dfu_usb_get_reset(void);
 int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
+int dfu_write_direct(struct dfu_entity *de, void *buf, long size);
 
 /**
  * dfu_write_from_mem_addr - write data from memory to DFU managed medium
@@ -146,6 +146,9 @@
  * @fifoth_val:	Value for FIFOTH register (or 0 to leave unset)
  * @mmc:	Pointer to generic MMC structure for this device
  * @priv:	Private pointer for use by controller
+ * @idmac:	IDMAC descriptor pool, allocated on the first DMA transfer
+ * @idmac_cnt:	Number of descriptors in @idmac
+ * @align_buf:	Bounce area for the unaligned head and tail of a read
  */
 struct dwmci_host {
 	const char *name;
@@ -181,18 +184,34 @@ struct dwmci_host {
 	 */
 	unsigned int (*get_mmc_clk)(struct dwmci_host *host, uint freq);
 
+	/**
+	 * Select the sampling point for the current bus timing
+	 *
+	 * Called once the card runs at its final clock and bus mode. Returns
+	 * 0 on success, or an error after restoring the default timing, in
+	 * which case the core may retry in a slower bus mode.
+	 *
+	 * @host:	DWMMC host
+	 */
+	int (*execute_tuning)(struct dwmci_host *host);
+
 	struct mmc_config cfg;
 
 	/* use fifo mode to read and write data */
 	bool fifo_mode;
+
+	struct dwmci_idmac *idmac;
+	unsigned int idmac_cnt;
+	void *align_buf;
 };
 
+/* descriptors are packed, only the start of the pool is cache aligned */
 struct dwmci_idmac {
 	u32 flags;
 	u32 cnt;
 	u32 addr;
 	u32 next_addr;
-} __aligned(ARCH_DMA_MINALIGN);
+};
 
 static inline void dwmci_writel(struct dwmci_host *host, int reg, u32 val)
 {
@@ -224,4 +243,7 @@ static inline u8 dwmci_readb(struct dwmci_host *host, int reg)
 }
 
 int add_dwmci(struct dwmci_host *host, u32 max_clk, u32 min_clk);
+
+/* Set reset bits of DWMCI_CTRL and wait for them to clear; 0 on timeout */
+int dwmci_wait_reset(struct dwmci_host *host, u32 value);
 #endif	/* __DWMMC_HW_H */
@@ -0,0 +1,40 @@
+/*
+ * Hashing of environment variable names, shared by lib/hashtable.c and
+ * the tools/envhash generator of the default environment table
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __ENV_HASH_H__
+#define __ENV_HASH_H__
+
+/*
+ * Hash of a variable name: FNV-1a over all of it, as many names share a
+ * long prefix ("bootcmd_mmc0", "bootcmd_mmc1")
+ */
+static inline unsigned int env_hash(const char *key)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*key)
+		hash = (hash ^ (unsigned char)*key++) * 16777619;
+
+	return hash;
+}
+
+/*
+ * Place of a name among the 'size' places of the default environment
+ * table, given the displacement tools/envhash found for its bucket
+ */
+static inline unsigned int env_hash_slot(unsigned int hash, unsigned int disp,
+					 unsigned int size)
+{
+	hash ^= disp * 0x9e3779b9;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+
+	return hash % size;
+}
+
+#endif /* __ENV_HASH_H__ */
@@ -18,5 +18,6 @@
 
 void fastboot_fail(char *response, const char *reason);
 void fastboot_okay(char *response, const char *reason);
+void fastboot_poll(void);
 
 #endif /* _FASTBOOT_H_ */
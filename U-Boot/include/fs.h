@@ -36,6 +36,18 @@
  */
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype);
 
+/*
+ * fs_hold - Keep the partition set by fs_set_blk_dev() over the fs_read()
+ * calls that follow, e.g. to read a file piece by piece without probing
+ * the filesystem again for each piece. Other commands still close it.
+ */
+void fs_hold(void);
+
+/*
+ * fs_release - Undo fs_hold() and close the filesystem
+ */
+void fs_release(void);
+
 /*
  * Print the list of files on the partition previously set by fs_set_blk_dev(),
  * in directory "dirname".
@@ -853,6 +853,7 @@ int fit_image_get_data(const void *fit, int noffset,
 int fit_image_hash_get_algo(const void *fit, int noffset, char **algo);
 int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
 				int *value_len);
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore);
 
 int fit_set_timestamp(void *fit, int noffset, time_t timestamp);
 
@@ -881,6 +882,8 @@ int fit_add_verification_data(const char *keydir, void *keydest, void *fit,
 int fit_image_verify(const void *fit, int noffset);
 int fit_config_verify(const void *fit, int conf_noffset);
 int fit_all_image_verify(const void *fit);
+/* Drop the hashes fit_image_load() computed ahead for a configuration */
+void fit_hash_clear(void);
 int fit_image_check_os(const void *fit, int noffset, uint8_t os);
 int fit_image_check_arch(const void *fit, int noffset, uint8_t arch);
 int fit_image_check_type(const void *fit, int noffset, uint8_t type);
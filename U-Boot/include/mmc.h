@@ -64,6 +64,7 @@
 
 #define MMC_DATA_READ		1
 #define MMC_DATA_WRITE		2
+#define MMC_DATA_ASYNC		4 /* may be left running, see wait_data */
 
 #define NO_CARD_ERR		-16 /* No SD/MMC card inserted */
 #define UNUSABLE_ERR		-17 /* Unusable Card */
@@ -107,6 +108,7 @@
 #define SD_CMD_SWITCH_UHS18V		11
 
 #define SD_CMD_APP_SET_BUS_WIDTH	6
+#define SD_CMD_APP_SET_WR_BLK_ERASE_COUNT	23
 #define SD_CMD_ERASE_WR_BLK_START	32
 #define SD_CMD_ERASE_WR_BLK_END		33
 #define SD_CMD_APP_SEND_OP_COND		41
@@ -115,6 +117,7 @@
 /* SCR definitions in different words */
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
+#define SD_SCR_CMD23_SUPPORT	0x00000002	/* SCR bit 33 */
 
 #define OCR_BUSY		0x80000000
 #define OCR_HCS			0x40000000
@@ -329,6 +332,14 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	int (*execute_tuning)(struct mmc *mmc);
+	/*
+	 * Finish the data of a command sent with MMC_DATA_ASYNC. A host
+	 * with this op may return from send_cmd while the data still moves
+	 * and then keeps the flag; without it, or clearing the flag, the
+	 * data is done when send_cmd returns.
+	 */
+	int (*wait_data)(struct mmc *mmc, struct mmc_data *data);
 };
 
 struct mmc_config {
@@ -382,6 +393,9 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
+	struct mmc_data write_data;	/* of the last write transfer */
+	char write_busy;	/* 1 if its data may still be moving */
+	char write_stop;	/* 1 if it still needs STOP_TRANSMISSION */
 };
 
 struct mmc_hwpart_conf {
@@ -417,6 +431,9 @@ int mmc_set_dev(int dev_num);
 void print_mmc_devices(char separator);
 int get_mmc_num(void);
 int mmc_switch_part(int dev_num, unsigned int part_num);
+ulong mmc_bwrite_start(int dev_num, lbaint_t start, lbaint_t blkcnt,
+		       const void *src);
+int mmc_bwrite_wait(int dev_num);
 int mmc_hwpart_config(struct mmc *mmc, const struct mmc_hwpart_conf *conf,
 		      enum mmc_hwpart_conf_mode mode);
 int mmc_getcd(struct mmc *mmc);
@@ -126,6 +126,9 @@ enum eth_recv_flags {
  *		    ROM on the board. This is how the driver should expose it
  *		    to the network stack. This function should fill in the
  *		    eth_pdata::enetaddr field - optional
+ * rx_unplace: Take back every receive buffer the hardware still owns that
+ *	       was set up from net_rx_placer, so that nothing more is written
+ *	       to those addresses - optional
  */
 struct eth_ops {
 	int (*start)(struct udevice *dev);
@@ -138,6 +141,9 @@ struct eth_ops {
 #endif
 	int (*write_hwaddr)(struct udevice *dev);
 	int (*read_rom_hwaddr)(struct udevice *dev);
+#ifdef CONFIG_NET_RX_PLACE
+	int (*rx_unplace)(struct udevice *dev);
+#endif
 };
 
 #define eth_get_ops(dev) ((struct eth_ops *)(dev)->driver->ops)
@@ -264,6 +270,46 @@ int eth_mcast_join(struct in_addr mcast_addr, int join);
 u32 ether_crc(size_t len, unsigned char const *p);
 #endif
 
+#ifdef CONFIG_NET_RX_PLACE
+#ifndef CONFIG_DM_ETH
+#error "CONFIG_NET_RX_PLACE needs CONFIG_DM_ETH"
+#endif
+/**
+ * struct net_rx_placer - receive payload straight to where it belongs
+ *
+ * A protocol that knows where the payload of the coming frames goes (TFTP,
+ * into the load buffer) can register one of these with net_set_rx_placer().
+ * A driver that can split a frame into a header buffer and a payload buffer
+ * asks place() for the payload address when it refills a descriptor, and
+ * calls placed() when that descriptor comes back. If the frame is the one
+ * the address was handed out for, the driver sets net_rx_placed_data and
+ * passes up only the headers; the protocol then skips its copy. Otherwise
+ * the driver copies the payload back behind the headers and passes the
+ * frame up as usual.
+ *
+ * @hdr_len:	Number of header bytes in front of the payload
+ * @place:	Return the payload address for the frame expected @ahead
+ *		frames after the last one handled, or NULL for a normal
+ *		buffer. The driver may write @reach bytes there.
+ * @placed:	Return 1 if the frame whose headers are at @hdr (@len bytes
+ *		in all) carries the payload that belongs at @dst
+ */
+struct net_rx_placer {
+	int hdr_len;
+	uchar *(*place)(int ahead, int reach);
+	int (*placed)(uchar *hdr, int len, uchar *dst);
+};
+
+extern struct net_rx_placer *net_rx_placer;
+/* Payload of the frame being processed is already at this address */
+extern uchar *net_rx_placed_data;
+
+/* Set or (with NULL) clear the placer, taking back placed buffers */
+void net_set_rx_placer(struct net_rx_placer *placer);
+/* Make the driver take back all placed buffers it still owns */
+int eth_rx_unplace(void);
+#endif
+
 
 /**********************************************************************/
 /*
@@ -151,6 +151,34 @@ static inline int get_device_and_partition(const char *ifname,
 { *dev_desc = NULL; return -1; }
 #endif
 
+/* drivers/block/blkcache.c */
+struct block_cache_stats {
+	unsigned hits;
+	unsigned misses;
+	unsigned entries;		/* current entry count */
+	unsigned max_blocks_per_entry;	/* also the read-ahead, in blocks */
+	unsigned max_entries;
+};
+
+#if defined(CONFIG_BLOCK_CACHE) && !defined(CONFIG_SPL_BUILD)
+/*
+ * Read 'blkcnt' blocks from 'start' like dev_desc->block_read(), going
+ * through the block cache. Small reads are served from the cache, or read
+ * ahead to a whole entry and kept there.
+ */
+ulong blk_dread(block_dev_desc_t *dev_desc, lbaint_t start, lbaint_t blkcnt,
+		void *buffer);
+/* Drop what is cached for a device, when it is written or changed */
+void blkcache_invalidate(int if_type, int dev);
+void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_stats(struct block_cache_stats *stats);
+#else
+static inline ulong blk_dread(block_dev_desc_t *dev_desc, lbaint_t start,
+			      lbaint_t blkcnt, void *buffer)
+{ return dev_desc->block_read(dev_desc->dev, start, blkcnt, buffer); }
+static inline void blkcache_invalidate(int if_type, int dev) {}
+#endif
+
 #ifdef CONFIG_MAC_PARTITION
 /* disk/part_mac.c */
 int get_partition_info_mac (block_dev_desc_t * dev_desc, int part, disk_partition_t *info);
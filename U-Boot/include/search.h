@@ -41,6 +41,7 @@ typedef struct entry {
 
 /* Opaque type for internal use.  */
 struct _ENTRY;
+struct text_buf;
 
 /*
  * Family of hash table handling functions.  The functions also
@@ -62,6 +63,13 @@ struct hsearch_data {
  */
 	int (*change_ok)(const ENTRY *__item, const char *newval, enum env_op,
 		int flag);
+/* Text being imported by himport_r(), which new entries point into */
+	struct text_buf *import;
+	const char *import_end;
+/* Where copies of changed names and values are made */
+	struct text_buf *arena;
+	char *arena_next;
+	char *arena_end;
 };
 
 /* Create a new hashing table which will at most contain NEL elements.  */
@@ -20,6 +20,9 @@
 #include <watchdog.h>
 #endif
 #include "u-boot/zlib.h"
+#if defined(CONFIG_ARMV8_CRYPTO) && !defined(USE_HOSTCC)
+#include <asm/armv8/crypto.h>
+#endif
 
 #define local static
 #define ZEXPORT	/* empty */
@@ -181,6 +184,10 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
+#if defined(CONFIG_ARMV8_CRYPTO) && !defined(USE_HOSTCC)
+    if (armv8_has_crc32())
+      return crc32_armv8(crc, buf, len);
+#endif
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
       make_crc_table();
@@ -41,33 +41,43 @@ void gzfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
-int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+int gzip_parse_header(const unsigned char *src, unsigned long len)
 {
 	int i, flags;
 
 	/* skip header */
+	if (len < 10 || src[2] != DEFLATED || (src[3] & RESERVED) != 0) {
+		puts("Error: Bad gzipped data\n");
+		return -1;
+	}
 	i = 10;
 	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
-		puts ("Error: Bad gzipped data\n");
-		return (-1);
-	}
-	if ((flags & EXTRA_FIELD) != 0)
+	if ((flags & EXTRA_FIELD) != 0 && len >= 12)
 		i = 12 + src[10] + (src[11] << 8);
 	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & HEAD_CRC) != 0)
 		i += 2;
-	if (i >= *lenp) {
-		puts ("Error: gunzip out of data in header\n");
-		return (-1);
+	if (i >= len) {
+		puts("Error: gunzip out of data in header\n");
+		return -1;
 	}
 
-	return zunzip(dst, dstlen, src, lenp, 1, i);
+	return i;
+}
+
+int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	int offset = gzip_parse_header(src, *lenp);
+
+	if (offset < 0)
+		return offset;
+
+	return zunzip(dst, dstlen, src, lenp, 1, offset);
 }
 
 __weak
@@ -109,7 +119,7 @@ int gzwrite(unsigned char *src, int len,
 	    u64 startoffs,
 	    u64 szexpected)
 {
-	int i, flags;
+	int i;
 	z_stream s;
 	int r = 0;
 	unsigned char *writebuf;
@@ -137,24 +147,9 @@ int gzwrite(unsigned char *src, int len,
 	blksperbuf = szwritebuf / dev->blksz;
 	outblock = lldiv(startoffs, dev->blksz);
 
-	/* skip header */
-	i = 10;
-	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
-		puts("Error: Bad gzipped data\n");
+	i = gzip_parse_header(src, len);
+	if (i < 0)
 		return -1;
-	}
-	if ((flags & EXTRA_FIELD) != 0)
-		i = 12 + src[10] + (src[11] << 8);
-	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
-			;
-	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
-			;
-	if ((flags & HEAD_CRC) != 0)
-		i += 2;
-
 	if (i >= len-8) {
 		puts("Error: gunzip out of data in header");
 		return -1;
@@ -43,9 +43,26 @@
 
 #include <env_callback.h>
 #include <env_flags.h>
+#include <env_hash.h>
 #include <search.h>
 #include <slre.h>
 
+/* size of the chunks copies of names and values are made in */
+#define ARENA_CHUNK	1024
+
+/* A variable of the default environment, see tools/envhash.c */
+struct env_default {
+	unsigned int hash;
+	const char *key;
+	const char *data;
+};
+
+#if defined(CONFIG_ENV_DEFAULT_HASH) && !defined(CONFIG_SPL_BUILD)
+#include <generated/env_default_hash.h>
+#else
+#define ENV_DEFAULT_SLOTS	0
+#endif
+
 /*
  * [Aho,Sethi,Ullman] Compilers: Principles, Techniques and Tools, 1986
  * [Knuth]	      The Art of Computer Programming, part 3 (6.4)
@@ -59,13 +76,153 @@
 
 typedef struct _ENTRY {
 	int used;
+	unsigned int hash;	/* of the whole key, compared before strcmp() */
+	/* text the key or data point into, NULL for the default environment */
+	struct text_buf *key_buf;
+	struct text_buf *data_buf;
 	ENTRY entry;
 } _ENTRY;
 
+/*
+ * Text the names and values of the entries point into: either what
+ * himport_r() parsed, in a single allocation rather than two for each
+ * entry, or a chunk of the arena that names and values set later are
+ * copied to. It is freed when nothing points into it any more.
+ */
+struct text_buf {
+	unsigned int refs;
+	char data[];
+};
+
 
 static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	int idx);
 
+static void text_put(struct text_buf *buf)
+{
+	if (buf && !--buf->refs)
+		free(buf);
+}
+
+/*
+ * Point to 's' if it is in the text being imported, else to a copy of it
+ * in the arena; a long one gets a chunk of its own. Returns the text
+ * pointed into, or NULL with *dst NULL when out of memory.
+ */
+static struct text_buf *text_ref(struct hsearch_data *htab,
+				 const char *s, char **dst)
+{
+	struct text_buf *buf = htab->import;
+	size_t len;
+
+	if (buf && s >= buf->data && s < htab->import_end) {
+		*dst = (char *)s;
+		buf->refs++;
+		return buf;
+	}
+
+	len = strlen(s) + 1;
+	if (len > ARENA_CHUNK / 4) {
+		buf = malloc(sizeof(*buf) + len);
+		if (!buf) {
+			*dst = NULL;
+			return NULL;
+		}
+		buf->refs = 1;
+		*dst = memcpy(buf->data, s, len);
+		return buf;
+	}
+
+	if (!htab->arena || htab->arena_end - htab->arena_next < len) {
+		buf = malloc(sizeof(*buf) + ARENA_CHUNK);
+		if (!buf) {
+			*dst = NULL;
+			return NULL;
+		}
+		/* held while copies are made in it */
+		buf->refs = 1;
+		text_put(htab->arena);
+		htab->arena = buf;
+		htab->arena_next = buf->data;
+		htab->arena_end = buf->data + ARENA_CHUNK;
+	}
+
+	buf = htab->arena;
+	buf->refs++;
+	*dst = memcpy(htab->arena_next, s, len);
+	htab->arena_next += len;
+	return buf;
+}
+
+/*
+ * The variables of the default environment have fixed places after the
+ * table proper, found by the perfect hash tools/envhash built for them.
+ * Returns the place of 'key', or 0.
+ */
+static unsigned int default_idx(struct hsearch_data *htab, const char *key,
+				unsigned int hash)
+{
+#if ENV_DEFAULT_SLOTS
+	unsigned int i = env_hash_slot(hash,
+			env_default_disp[hash % ENV_DEFAULT_BUCKETS],
+			ENV_DEFAULT_SLOTS);
+	const struct env_default *dv = &env_default_vars[i];
+
+	if (dv->key && dv->hash == hash && !strcmp(dv->key, key))
+		return htab->size + 1 + i;
+#endif
+	return 0;
+}
+
+/* The default of the variable at 'idx', or NULL */
+static const struct env_default *default_var(struct hsearch_data *htab,
+					     unsigned int idx)
+{
+#if ENV_DEFAULT_SLOTS
+	if (idx > htab->size)
+		return &env_default_vars[idx - htab->size - 1];
+#endif
+	return NULL;
+}
+
+/*
+ * Set the data of the entry at 'idx': an unchanged default points into
+ * the read-only table, anything else is shared or copied by text_ref()
+ */
+static int set_data(struct hsearch_data *htab, unsigned int idx,
+		    const char *data)
+{
+	const struct env_default *dv = default_var(htab, idx);
+	_ENTRY *ep = &htab->table[idx];
+
+	if (dv && !strcmp(data, dv->data)) {
+		ep->entry.data = (char *)dv->data;
+		ep->data_buf = NULL;
+		return 0;
+	}
+
+	ep->data_buf = text_ref(htab, data, &ep->entry.data);
+	return ep->entry.data ? 0 : -ENOMEM;
+}
+
+static void free_key(_ENTRY *ep)
+{
+	text_put(ep->key_buf);
+	ep->key_buf = NULL;
+}
+
+static void free_data(_ENTRY *ep)
+{
+	text_put(ep->data_buf);
+	ep->data_buf = NULL;
+}
+
+static void free_entry(_ENTRY *ep)
+{
+	free_key(ep);
+	free_data(ep);
+}
+
 /*
  * hcreate()
  */
@@ -117,8 +274,9 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 	htab->size = nel;
 	htab->filled = 0;
 
-	/* allocate memory and zero out */
-	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
+	/* allocate memory and zero out, the default environment follows */
+	htab->table = (_ENTRY *) calloc(htab->size + 1 + ENV_DEFAULT_SLOTS,
+					sizeof(_ENTRY));
 	if (htab->table == NULL)
 		return 0;
 
@@ -147,15 +305,13 @@ void hdestroy_r(struct hsearch_data *htab)
 	}
 
 	/* free used memory */
-	for (i = 1; i <= htab->size; ++i) {
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-
-			free((void *)ep->key);
-			free(ep->data);
-		}
+	for (i = 1; i <= htab->size + ENV_DEFAULT_SLOTS; ++i) {
+		if (htab->table[i].used > 0)
+			free_entry(&htab->table[i]);
 	}
 	free(htab->table);
+	text_put(htab->arena);
+	htab->arena = NULL;
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
@@ -204,7 +360,7 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	unsigned int idx;
 	size_t key_len = strlen(match);
 
-	for (idx = last_idx + 1; idx < htab->size; ++idx) {
+	for (idx = last_idx + 1; idx <= htab->size + ENV_DEFAULT_SLOTS; ++idx) {
 		if (htab->table[idx].used <= 0)
 			continue;
 		if (!strncmp(match, htab->table[idx].entry.key, key_len)) {
@@ -218,52 +374,61 @@ int hmatch_r(const char *match, int last_idx, ENTRY ** retval,
 	return 0;
 }
 
+/*
+ * Overwrite an existing entry if the action is ENTER.  This is simply a
+ * helper function for hsearch_r().
+ */
+static int _overwrite_entry(ENTRY item, ACTION action, ENTRY **retval,
+	struct hsearch_data *htab, int flag, unsigned int idx)
+{
+	/* Overwrite existing value? */
+	if ((action == ENTER) && (item.data != NULL)) {
+		/* check for permission */
+		if (htab->change_ok != NULL && htab->change_ok(
+		    &htab->table[idx].entry, item.data,
+		    env_op_overwrite, flag)) {
+			debug("change_ok() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EPERM);
+			*retval = NULL;
+			return 0;
+		}
+
+		/* If there is a callback, call it */
+		if (htab->table[idx].entry.callback &&
+		    htab->table[idx].entry.callback(item.key,
+		    item.data, env_op_overwrite, flag)) {
+			debug("callback() rejected setting variable "
+				"%s, skipping it!\n", item.key);
+			__set_errno(EINVAL);
+			*retval = NULL;
+			return 0;
+		}
+
+		free_data(&htab->table[idx]);
+		if (set_data(htab, idx, item.data)) {
+			__set_errno(ENOMEM);
+			*retval = NULL;
+			return 0;
+		}
+	}
+	/* return found entry */
+	*retval = &htab->table[idx].entry;
+	return idx;
+}
+
 /*
  * Compare an existing entry with the desired key, and overwrite if the action
  * is ENTER.  This is simply a helper function for hsearch_r().
  */
 static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 	ENTRY **retval, struct hsearch_data *htab, int flag,
-	unsigned int hval, unsigned int idx)
+	unsigned int hval, unsigned int hash, unsigned int idx)
 {
-	if (htab->table[idx].used == hval
-	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
-		/* Overwrite existing value? */
-		if ((action == ENTER) && (item.data != NULL)) {
-			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
-			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
-				debug("change_ok() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EPERM);
-				*retval = NULL;
-				return 0;
-			}
-
-			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
-			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
-				debug("callback() rejected setting variable "
-					"%s, skipping it!\n", item.key);
-				__set_errno(EINVAL);
-				*retval = NULL;
-				return 0;
-			}
+	if (htab->table[idx].used == hval && htab->table[idx].hash == hash
+	    && strcmp(item.key, htab->table[idx].entry.key) == 0)
+		return _overwrite_entry(item, action, retval, htab, flag, idx);
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
-				__set_errno(ENOMEM);
-				*retval = NULL;
-				return 0;
-			}
-		}
-		/* return found entry */
-		*retval = &htab->table[idx].entry;
-		return idx;
-	}
 	/* keep searching */
 	return -1;
 }
@@ -272,32 +437,34 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	      struct hsearch_data *htab, int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
+	unsigned int hash;
 	unsigned int idx;
 	unsigned int first_deleted = 0;
+	unsigned int dflt;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
+	/* Compute a value for the given string. */
+	hash = env_hash(item.key);
 
 	/*
 	 * First hash function:
 	 * simply take the modul but prevent zero.
 	 */
-	hval %= htab->size;
+	hval = hash % htab->size;
 	if (hval == 0)
 		++hval;
 
 	/* The first index tried. */
 	idx = hval;
 
-	if (htab->table[idx].used) {
+	/* A variable of the default environment has a place of its own */
+	dflt = default_idx(htab, item.key, hash);
+	if (dflt) {
+		idx = dflt;
+		if (htab->table[idx].used)
+			return _overwrite_entry(item, action, retval, htab,
+						flag, idx);
+	} else if (htab->table[idx].used) {
 		/*
 		 * Further action might be required according to the
 		 * action value.
@@ -309,7 +476,7 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 			first_deleted = idx;
 
 		ret = _compare_and_overwrite_entry(item, action, retval, htab,
-			flag, hval, idx);
+			flag, hval, hash, idx);
 		if (ret != -1)
 			return ret;
 
@@ -338,7 +505,7 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 
 			/* If entry is found use it. */
 			ret = _compare_and_overwrite_entry(item, action, retval,
-				htab, flag, hval, idx);
+				htab, flag, hval, hash, idx);
 			if (ret != -1)
 				return ret;
 		}
@@ -351,7 +518,7 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		 * If table is full and another entry should be
 		 * entered return with error.
 		 */
-		if (htab->filled == htab->size) {
+		if (!dflt && htab->filled == htab->size) {
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
@@ -359,23 +526,31 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 
 		/*
 		 * Create new entry;
-		 * create copies of item.key and item.data
+		 * create copies of item.key and item.data, unless they are
+		 * in the text being imported
 		 */
 		if (first_deleted)
 			idx = first_deleted;
 
 		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
+		htab->table[idx].hash = hash;
+		if (dflt) {
+			htab->table[idx].entry.key =
+				default_var(htab, idx)->key;
+			htab->table[idx].key_buf = NULL;
+		} else {
+			htab->table[idx].key_buf = text_ref(htab, item.key,
+					(char **)&htab->table[idx].entry.key);
+			++htab->filled;
+		}
 		if (!htab->table[idx].entry.key ||
-		    !htab->table[idx].entry.data) {
+		    set_data(htab, idx, item.data)) {
+			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
 			__set_errno(ENOMEM);
 			*retval = NULL;
 			return 0;
 		}
 
-		++htab->filled;
-
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
 		/* Also look for flags */
@@ -430,10 +605,15 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 {
 	/* free used ENTRY */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
+	free_entry(&htab->table[idx]);
 	ep->callback = NULL;
 	ep->flags = 0;
+
+	/* the places of the default environment are never probed past */
+	if (idx > htab->size) {
+		htab->table[idx].used = 0;
+		return;
+	}
 	htab->table[idx].used = -1;
 
 	--htab->filled;
@@ -591,7 +771,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
+	ENTRY *list[htab->size + ENV_DEFAULT_SLOTS];
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -609,7 +789,8 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	 * search used entries,
 	 * save addresses and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
+	for (i = 1, n = 0, totlen = 0; i <= htab->size + ENV_DEFAULT_SLOTS;
+	     ++i) {
 
 		if (htab->table[i].used > 0) {
 			ENTRY *ep = &htab->table[i].entry;
@@ -778,8 +959,10 @@ int himport_r(struct hsearch_data *htab,
 		const char *env, size_t size, const char sep, int flag,
 		int crlf_is_lf, int nvars, char * const vars[])
 {
+	struct text_buf *buf;
 	char *data, *sp, *dp, *name, *value;
 	char *localvars[nvars];
+	size_t len;
 	int i;
 
 	/* Test for correct arguments.  */
@@ -788,14 +971,27 @@ int himport_r(struct hsearch_data *htab,
 		return 0;
 	}
 
+	/*
+	 * Parsing stops at the latest at two NULs in a row; the rest of an
+	 * environment area is not worth keeping
+	 */
+	for (len = 0; len + 1 < size; len++)
+		if (!env[len] && !env[len + 1])
+			break;
+	len = len + 2 < size ? len + 2 : size;
+
 	/* we allocate new space to make sure we can write to the array */
-	if ((data = malloc(size + 1)) == NULL) {
-		debug("himport_r: can't malloc %zu bytes\n", size + 1);
+	buf = malloc(sizeof(*buf) + len + 1);
+	if (buf == NULL) {
+		debug("himport_r: can't malloc %zu bytes\n", len + 1);
 		__set_errno(ENOMEM);
 		return 0;
 	}
-	memcpy(data, env, size);
-	data[size] = '\0';
+	/* held until the import is done, and then by the entries */
+	buf->refs = 1;
+	data = buf->data;
+	memcpy(data, env, len);
+	data[len] = '\0';
 	dp = data;
 
 	/* make a local copy of the list of variables */
@@ -837,15 +1033,21 @@ int himport_r(struct hsearch_data *htab,
 		debug("Create Hash Table: N=%d\n", nent);
 
 		if (hcreate_r(nent, htab) == 0) {
-			free(data);
+			free(buf);
 			return 0;
 		}
 	}
 
 	if (!size) {
-		free(data);
+		free(buf);
 		return 1;		/* everything OK */
 	}
+	size = len;
+
+	/* The entries point into the copy */
+	htab->import = buf;
+	htab->import_end = data + size + 1;
+
 	if(crlf_is_lf) {
 		/* Remove Carriage Returns in front of Line Feeds */
 		unsigned ignored_crs = 0;
@@ -909,7 +1111,8 @@ int himport_r(struct hsearch_data *htab,
 		if (*name == 0) {
 			debug("INSERT: unable to use an empty key\n");
 			__set_errno(EINVAL);
-			free(data);
+			htab->import = NULL;
+			text_put(buf);
 			return 0;
 		}
 
@@ -931,8 +1134,8 @@ int himport_r(struct hsearch_data *htab,
 			rv, name, value);
 	} while ((dp < data + size) && *dp);	/* size check needed for text */
 						/* without '\0' termination */
-	debug("INSERT: free(data = %p)\n", data);
-	free(data);
+	htab->import = NULL;
+	text_put(buf);
 
 	/* process variables which were not considered */
 	for (i = 0; i < nvars; i++) {
@@ -969,7 +1172,7 @@ int hwalk_r(struct hsearch_data *htab, int (*callback)(ENTRY *))
 	int i;
 	int retval;
 
-	for (i = 1; i <= htab->size; ++i) {
+	for (i = 1; i <= htab->size + ENV_DEFAULT_SLOTS; ++i) {
 		if (htab->table[i].used > 0) {
 			retval = callback(&htab->table[i].entry);
 			if (retval)
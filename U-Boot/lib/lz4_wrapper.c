@@ -6,6 +6,8 @@
 
 #include <common.h>
 #include <compiler.h>
+#include <cpu_work.h>
+#include <malloc.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 
@@ -63,12 +65,125 @@ struct lz4_block_header {
 	/* + u32 block_checksum iff has_block_checksum is set */
 } __packed;
 
+#ifdef CONFIG_CPU_WORK
+/*
+ * The blocks of a frame are independent, so they are decompressed on all
+ * cores. Each block but the last holds a full maximum block size of data,
+ * as the reference encoder writes them, so block i goes to i times that
+ * size in the output; anything else is left to the serial loop.
+ */
+struct lz4_blocks {
+	const void **in;	/* block headers */
+	int *len;		/* decompressed size, or < 0 */
+	int count;
+	int next;		/* next block to take */
+	void *dst;
+	const void *end;
+	size_t block_size;
+};
+
+static void ulz4_blocks_work(void *arg)
+{
+	struct lz4_blocks *p = arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) <
+	       p->count) {
+		struct lz4_block_header b;
+		const void *in = p->in[i];
+		void *out = p->dst + i * p->block_size;
+		size_t room = min((size_t)(p->end - out), p->block_size);
+
+		b.raw = le32_to_cpu(*(u32 *)in);
+		in += sizeof(struct lz4_block_header);
+
+		if (b.not_compressed) {
+			if (b.size > room) {
+				p->len[i] = -ENOBUFS;
+				continue;
+			}
+			memcpy(out, in, b.size);
+			p->len[i] = b.size;
+		} else {
+			p->len[i] = LZ4_decompress_generic(in, out, b.size,
+					room, endOnInputSize,
+					full, 0, noDict, out, NULL, 0);
+		}
+	}
+}
+
+/* Returns -EAGAIN if the frame is to be done the usual way */
+static int ulz4fn_blocks(const void *src, size_t srcn, const void *in,
+			 int has_block_checksum, size_t block_size,
+			 void *dst, const void *end, size_t *dstn)
+{
+	struct lz4_blocks p;
+	const void *pos;
+	int count, i, ret = -EAGAIN;
+
+	for (pos = in, count = 0; ; count++) {
+		struct lz4_block_header b;
+
+		if (pos - src + sizeof(b) > srcn)
+			return -EAGAIN;
+		b.raw = le32_to_cpu(*(u32 *)pos);
+		pos += sizeof(b);
+		if (!b.size)
+			break;
+		if (pos - src + b.size > srcn)
+			return -EAGAIN;
+		pos += b.size;
+		if (has_block_checksum)
+			pos += sizeof(u32);
+	}
+	if (count < 2 || (count - 1) * block_size >= end - dst)
+		return -EAGAIN;
+
+	p.in = malloc(count * (sizeof(*p.in) + sizeof(*p.len)));
+	if (!p.in)
+		return -EAGAIN;
+	p.len = (int *)(p.in + count);
+	for (pos = in, i = 0; i < count; i++) {
+		struct lz4_block_header b;
+
+		p.in[i] = pos;
+		b.raw = le32_to_cpu(*(u32 *)pos);
+		pos += sizeof(b) + b.size;
+		if (has_block_checksum)
+			pos += sizeof(u32);
+	}
+	p.count = count;
+	p.next = 0;
+	p.dst = dst;
+	p.end = end;
+	p.block_size = block_size;
+
+	/* Done the usual way if a core left its blocks unfinished */
+	if (cpu_work_run(ulz4_blocks_work, &p) < 0)
+		goto out;
+
+	for (i = 0; i < count; i++)
+		if (p.len[i] < 0 ||
+		    (i < count - 1 && p.len[i] != block_size))
+			goto out;
+
+	*dstn = (count - 1) * block_size + p.len[count - 1];
+	ret = 0;
+out:
+	free(p.in);
+	return ret;
+}
+#endif
+
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 {
 	const void *end = dst + *dstn;
 	const void *in = src;
 	void *out = dst;
 	int has_block_checksum;
+#ifdef CONFIG_CPU_WORK
+	size_t block_size;
+#endif
 	int ret;
 	*dstn = 0;
 
@@ -86,6 +201,9 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		if (!h->independent_blocks)
 			return -EPROTONOSUPPORT; /* we can't support this yet */
 		has_block_checksum = h->has_block_checksum;
+#ifdef CONFIG_CPU_WORK
+		block_size = 1 << (8 + 2 * h->max_block_size);
+#endif
 
 		in += sizeof(*h);
 		if (h->has_content_size)
@@ -93,6 +211,16 @@ int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
 		in += sizeof(u8);
 	}
 
+#ifdef CONFIG_CPU_WORK
+	/* Not in place: blocks are written out of order */
+	if (end <= src || dst >= src + srcn) {
+		ret = ulz4fn_blocks(src, srcn, in, has_block_checksum,
+				    block_size, dst, end, dstn);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+#endif
+
 	while (1) {
 		struct lz4_block_header b;
 
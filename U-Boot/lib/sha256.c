@@ -14,6 +14,9 @@
 #endif /* USE_HOSTCC */
 #include <watchdog.h>
 #include <u-boot/sha256.h>
+#if defined(CONFIG_ARMV8_CRYPTO) && !defined(USE_HOSTCC)
+#include <asm/armv8/crypto.h>
+#endif
 
 /*
  * 32-bit integer manipulation macros (big endian)
@@ -181,6 +184,21 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	ctx->state[7] += H;
 }
 
+static void sha256_blocks(sha256_context *ctx, const uint8_t *data,
+			  uint32_t blocks)
+{
+#if defined(CONFIG_ARMV8_CRYPTO) && !defined(USE_HOSTCC)
+	if (armv8_has_sha256()) {
+		sha256_armv8_blocks(ctx->state, data, blocks);
+		return;
+	}
+#endif
+	while (blocks--) {
+		sha256_process(ctx, data);
+		data += 64;
+	}
+}
+
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 {
 	uint32_t left, fill;
@@ -199,16 +217,16 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		sha256_blocks(ctx, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		sha256_blocks(ctx, input, length / 64);
+		input += length & ~0x3F;
+		length &= 0x3F;
 	}
 
 	if (length)
@@ -479,6 +479,22 @@ int eth_rx(void)
 	return ret;
 }
 
+#ifdef CONFIG_NET_RX_PLACE
+int eth_rx_unplace(void)
+{
+	struct udevice *current;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!device_active(current) || !eth_get_ops(current)->rx_unplace)
+		return 0;
+
+	return eth_get_ops(current)->rx_unplace(current);
+}
+#endif
+
 int eth_initialize(void)
 {
 	int num_devices = 0;
@@ -195,6 +195,12 @@ static thand_f *time_handler;
 static ulong	time_start;
 /* Current timeout value */
 static ulong	time_delta;
+#ifdef CONFIG_NET_RX_PLACE
+/* Current receive placer */
+struct net_rx_placer *net_rx_placer;
+/* Payload of the current rx packet, if the driver placed it */
+uchar *net_rx_placed_data;
+#endif
 /* THE transmit packet */
 uchar *net_tx_packet;
 
@@ -353,6 +359,9 @@ static void net_clear_handlers(void)
 	net_set_udp_handler(NULL);
 	net_set_arp_handler(NULL);
 	net_set_timeout_handler(0, NULL);
+#ifdef CONFIG_NET_RX_PLACE
+	net_set_rx_placer(NULL);
+#endif
 }
 
 static void net_cleanup_loop(void)
@@ -774,6 +783,18 @@ void net_set_timeout_handler(ulong iv, thand_f *f)
 	}
 }
 
+#ifdef CONFIG_NET_RX_PLACE
+void net_set_rx_placer(struct net_rx_placer *placer)
+{
+	debug_cond(DEBUG_INT_STATE, "--- net_loop rx placer set (%p)\n",
+		   placer);
+	/* Buffers handed out by the old placer must not be written again */
+	if (net_rx_placer)
+		eth_rx_unplace();
+	net_rx_placer = placer;
+}
+#endif
+
 int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		int payload_len)
 {
@@ -133,6 +133,29 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 windowsize: number of blocks the server may send before it
+ * waits for an ACK. 1 is plain lock-step TFTP and is what we get whenever
+ * the server does not acknowledge the option. The receive bitmap below
+ * limits the window to 64 blocks.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+#define TFTP_MAX_WINDOWSIZE	64
+
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = TFTP_WINDOWSIZE;
+/* last block we have acknowledged */
+static ulong	tftp_last_ack;
+/* number of the final (short) block, once it has been seen */
+static ulong	tftp_final_block;
+static int	tftp_final_block_seen;
+/* bit n set: block tftp_prev_block + n + 1 is already stored */
+static u64	tftp_window_map;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -163,6 +186,232 @@ static void mcast_cleanup(void)
 
 #endif	/* CONFIG_MCAST_TFTP */
 
+/*
+ * Zero-copy receive: the driver is asked to put the payload of DATA
+ * packets straight into the load buffer. Only the part of the buffer the
+ * file is known (from tsize) to cover is handed out, never into flash.
+ */
+#if defined(CONFIG_NET_RX_PLACE) && defined(CONFIG_TFTP_TSIZE) && \
+	!defined(CONFIG_SYS_DIRECT_FLASH_TFTP)
+#define TFTP_RX_PLACE
+
+/* headers in front of the payload of a DATA packet */
+#define TFTP_PLACE_HDR_LEN	(ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + 4)
+
+static int	tftp_place_active;
+/* payload was found not to land in place, so it is never placed again */
+static int	tftp_place_broken;
+/* a placed block has been checked, and blocks placed in this transfer */
+static int	tftp_place_checked;
+static ulong	tftp_place_hits;
+/* highest block stored so far, counted from 0 across wraps */
+static ulong	tftp_place_seen;
+/* block after the last one handed out */
+static ulong	tftp_place_next;
+/* addresses handed out and not back yet, and the range they may write */
+static int	tftp_place_count;
+static ulong	tftp_place_lo;
+static ulong	tftp_place_hi;
+/*
+ * Bytes of a copied block that share a cache line with the oldest placed
+ * address. They are written once the DMA is done with that line.
+ */
+static uchar	tftp_place_stash[ARCH_DMA_MINALIGN];
+static ulong	tftp_place_stash_at;
+static ulong	tftp_place_stash_off;
+static int	tftp_place_stash_len;
+
+static void restart(const char *msg);
+
+static uchar *tftp_place(int ahead, int reach)
+{
+	ulong block = tftp_place_seen + ahead;
+	ulong offset;
+
+	/* Never hand out a block twice */
+	if (tftp_place_count)
+		block = max(block, tftp_place_next);
+	offset = block * tftp_block_size;
+
+	if (!tftp_place_active || offset + reach > tftp_tsize)
+		return NULL;
+
+	if (!tftp_place_count)
+		tftp_place_lo = offset;
+	tftp_place_hi = offset + reach;
+	tftp_place_count++;
+	tftp_place_next = block + 1;
+
+	return map_sysmem(load_addr + offset, reach);
+}
+
+static int tftp_placed(uchar *hdr, int len, uchar *dst)
+{
+	struct ethernet_hdr *et = (struct ethernet_hdr *)hdr;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(hdr + ETHER_HDR_SIZE);
+	__be16 *s = (__be16 *)(hdr + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE);
+	ulong offset = map_to_sysmem(dst) - load_addr;
+
+	if (tftp_place_count)
+		tftp_place_count--;
+	if (tftp_place_stash_len && offset == tftp_place_stash_at) {
+		uchar *ptr = map_sysmem(load_addr + tftp_place_stash_off,
+					tftp_place_stash_len);
+		ulong line = rounddown((ulong)ptr, ARCH_DMA_MINALIGN);
+
+		invalidate_dcache_range(line, line + ARCH_DMA_MINALIGN);
+		memcpy(ptr, tftp_place_stash, tftp_place_stash_len);
+		flush_dcache_range(line, line + ARCH_DMA_MINALIGN);
+		unmap_sysmem(ptr);
+		tftp_place_stash_len = 0;
+	}
+	/* Handed back unused: the newest ones, the range stays as it is */
+	if (!hdr)
+		return 0;
+	/* Addresses come back in the order they were handed out */
+	tftp_place_lo = offset + tftp_block_size;
+
+	return len >= TFTP_PLACE_HDR_LEN + tftp_block_size &&
+	       ntohs(et->et_protlen) == PROT_IP &&
+	       ip->ip_hl_v == 0x45 &&
+	       !(ntohs(ip->ip_off) & (IP_OFFS | IP_FLAGS_MFRAG)) &&
+	       ip->ip_p == IPPROTO_UDP &&
+	       net_read_ip(&ip->ip_src).s_addr == tftp_remote_ip.s_addr &&
+	       ntohs(ip->udp_dst) == tftp_our_port &&
+	       ntohs(ip->udp_src) == tftp_remote_port &&
+	       ntohs(ip->udp_len) == UDP_HDR_SIZE + 4 + tftp_block_size &&
+	       ntohs(s[0]) == TFTP_DATA &&
+	       ntohs(s[1]) == (ushort)(offset / tftp_block_size + 1);
+}
+
+static struct net_rx_placer tftp_rx_placer = {
+	.hdr_len	= TFTP_PLACE_HDR_LEN,
+	.place		= tftp_place,
+	.placed		= tftp_placed,
+};
+
+/*
+ * Called once the options are known. The DATA packets must come as whole,
+ * untagged frames; the buffer is cleaned so that no dirty cache line can
+ * be written back over placed payload.
+ */
+static void tftp_place_start(void)
+{
+	void *buf;
+
+	if (tftp_place_broken || tftp_put_active || tftp_tsize <= 0 ||
+	    TFTP_PLACE_HDR_LEN + tftp_block_size > ETHER_HDR_SIZE + 1500 ||
+	    (net_our_vlan & VLAN_IDMASK) != VLAN_NONE)
+		return;
+#ifdef CONFIG_MCAST_TFTP
+	if (tftp_mcast_active)
+		return;
+#endif
+
+	buf = map_sysmem(load_addr, tftp_tsize);
+	flush_dcache_range(rounddown((ulong)buf, ARCH_DMA_MINALIGN),
+			   roundup((ulong)buf + tftp_tsize, ARCH_DMA_MINALIGN));
+	unmap_sysmem(buf);
+
+	tftp_place_seen = 0;
+	tftp_place_next = 0;
+	tftp_place_count = 0;
+	tftp_place_stash_len = 0;
+	tftp_place_checked = 0;
+	tftp_place_hits = 0;
+	tftp_place_active = 1;
+	net_set_rx_placer(&tftp_rx_placer);
+}
+
+/*
+ * Check the UDP checksum of a block received in place, with its headers
+ * still in front of 'src' in the receive buffer. Returns 1 if it is good,
+ * 0 if not and -1 if the server sent none.
+ */
+static int tftp_place_check(uchar *ptr, uchar *src, unsigned len)
+{
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(src - 4 -
+						      IP_UDP_HDR_SIZE);
+	__be16 pseudo[6];
+	unsigned sum;
+
+	if (!ip->udp_xsum)
+		return -1;
+
+	net_copy_ip(&pseudo[0], &ip->ip_src);
+	net_copy_ip(&pseudo[2], &ip->ip_dst);
+	pseudo[4] = htons(IPPROTO_UDP);
+	pseudo[5] = ip->udp_len;
+	sum = compute_ip_checksum(pseudo, sizeof(pseudo));
+	sum = add_ip_checksums(sizeof(pseudo), sum,
+			       compute_ip_checksum((uchar *)ip + IP_HDR_SIZE,
+						   UDP_HDR_SIZE + 4));
+	sum = add_ip_checksums(sizeof(pseudo) + UDP_HDR_SIZE + 4, sum,
+			       compute_ip_checksum(ptr, len));
+
+	return !sum;
+}
+
+/*
+ * Store a block while placing. Placed payload is already there; anything
+ * else is copied and cleaned out of the cache, so that no line of it can
+ * be written back over placed payload later. A copy that ends in the cache
+ * line of the oldest placed address leaves the bytes in that line for
+ * tftp_placed(); one that reaches further makes the driver take back its
+ * placed addresses first.
+ */
+static void tftp_place_store(uchar *ptr, ulong offset, uchar *src,
+			     unsigned len)
+{
+	ulong block = offset / tftp_block_size;
+	ulong split;
+
+	if (block > tftp_place_seen)
+		tftp_place_seen = block;
+	if (ptr == net_rx_placed_data) {
+		/* Make sure once that the driver got the layout right */
+		if (!tftp_place_checked) {
+			int ret = tftp_place_check(ptr, src, len);
+
+			if (!ret) {
+				tftp_place_broken = 1;
+				tftp_place_active = 0;
+				net_set_rx_placer(NULL);
+				restart("TFTP data received in place is corrupt");
+				return;
+			}
+			tftp_place_checked = ret > 0;
+		}
+		tftp_place_hits++;
+		return;
+	}
+
+	split = rounddown(load_addr + tftp_place_lo, ARCH_DMA_MINALIGN) -
+		load_addr;
+	if (tftp_place_count && offset + len > split &&
+	    offset < tftp_place_hi + ARCH_DMA_MINALIGN) {
+		if (offset + len <= tftp_place_lo && !tftp_place_stash_len) {
+			tftp_place_stash_off = max(offset, split);
+			tftp_place_stash_len = offset + len -
+				tftp_place_stash_off;
+			tftp_place_stash_at = tftp_place_lo;
+			memcpy(tftp_place_stash,
+			       src + tftp_place_stash_off - offset,
+			       tftp_place_stash_len);
+			len -= tftp_place_stash_len;
+		} else if (eth_rx_unplace()) {
+			tftp_place_active = 0;
+			restart("TFTP receive buffers stuck");
+			return;
+		}
+	}
+
+	memcpy(ptr, src, len);
+	flush_dcache_range(rounddown((ulong)ptr, ARCH_DMA_MINALIGN),
+			   roundup((ulong)ptr + len, ARCH_DMA_MINALIGN));
+}
+#endif /* TFTP_RX_PLACE */
+
 static inline void store_block(int block, uchar *src, unsigned len)
 {
 	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
@@ -192,6 +441,11 @@ static inline void store_block(int block, uchar *src, unsigned len)
 	{
 		void *ptr = map_sysmem(load_addr + offset, len);
 
+#ifdef TFTP_RX_PLACE
+		if (tftp_place_active)
+			tftp_place_store(ptr, offset, src, len);
+		else
+#endif
 		memcpy(ptr, src, len);
 		unmap_sysmem(ptr);
 	}
@@ -210,6 +464,9 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_last_ack = 0;
+	tftp_final_block_seen = 0;
+	tftp_window_map = 0;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -243,6 +500,19 @@ static void tftp_timeout_handler(void);
 
 /**********************************************************************/
 
+/* Print the average rate of the transfer so far */
+static void show_block_rate(void)
+{
+	ulong ms = get_timer(time_start);
+	ulong bytes = tftp_cur_block * tftp_block_size +
+		tftp_block_wrap_offset;
+
+	if (ms > 0) {
+		putc(' ');
+		print_size(bytes / ms * 1000, "/s");
+	}
+}
+
 static void show_block_marker(void)
 {
 #ifdef CONFIG_TFTP_TSIZE
@@ -255,14 +525,22 @@ static void show_block_marker(void)
 		while (tftp_tsize_num_hash < pos * 50 / tftp_tsize) {
 			putc('#');
 			tftp_tsize_num_hash++;
+			/* five lines of ten, ending in the rate so far */
+			if (tftp_tsize_num_hash % 10 == 0 &&
+			    tftp_tsize_num_hash < 50) {
+				show_block_rate();
+				puts("\n\t ");
+			}
 		}
 	} else
 #endif
 	{
 		if (((tftp_cur_block - 1) % 10) == 0)
 			putc('#');
-		else if ((tftp_cur_block % (10 * HASHES_PER_LINE)) == 0)
+		else if ((tftp_cur_block % (10 * HASHES_PER_LINE)) == 0) {
+			show_block_rate();
 			puts("\n\t ");
+		}
 	}
 }
 
@@ -313,6 +591,10 @@ static void tftp_complete(void)
 	}
 	puts("  ");
 	print_size(tftp_tsize, "");
+#endif
+#ifdef TFTP_RX_PLACE
+	if (tftp_place_hits)
+		printf(" (%lu blocks in place)", tftp_place_hits);
 #endif
 	time_start = get_timer(time_start);
 	if (time_start > 0) {
@@ -371,6 +653,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* and for more than one block in flight (RFC 7440) */
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_windowsize_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -456,6 +742,72 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/*
+ * Receive a DATA block when a window larger than one block was negotiated.
+ *
+ * Any block inside the window is stored as soon as it arrives, so blocks
+ * that overtake each other do not cost a retransmission. The window only
+ * slides over blocks that are present in sequence, and tftp_cur_block is
+ * left at the last of those so that a timeout ACKs the right block.
+ *
+ * The server is acknowledged once per window, on the final block, or when
+ * the end of the window has been seen with a gap in front of it. In the
+ * last case the ACK names the last in-sequence block, which makes the
+ * server restart its window from the first missing one (RFC 7440 sec. 4).
+ */
+static void tftp_window_data(uchar *data, unsigned len)
+{
+	ushort block = tftp_cur_block;
+	ushort dist = block - tftp_prev_block;
+	u64 bit;
+
+	if (dist == 0 || dist > tftp_windowsize) {
+		/*
+		 * Resent or stale block. If the server is repeating the
+		 * window we last acknowledged, our ACK got lost.
+		 */
+		tftp_cur_block = tftp_prev_block;
+		if (block == tftp_last_ack)
+			tftp_send();
+		return;
+	}
+
+	bit = 1ULL << (dist - 1);
+	if (!(tftp_window_map & bit)) {
+		timeout_count_max = tftp_timeout_count_max;
+		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+
+		store_block(tftp_prev_block + dist - 1, data, len);
+		tftp_window_map |= bit;
+		if (len < tftp_block_size) {
+			tftp_final_block = block;
+			tftp_final_block_seen = 1;
+		}
+	}
+
+	while (tftp_window_map & 1) {
+		tftp_window_map >>= 1;
+		tftp_cur_block = (ushort)(tftp_prev_block + 1);
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+	}
+	tftp_cur_block = tftp_prev_block;
+
+	if (tftp_final_block_seen && tftp_prev_block == tftp_final_block) {
+		tftp_send();
+		tftp_complete();
+		return;
+	}
+
+	if ((ushort)(tftp_prev_block - tftp_last_ack) >= tftp_windowsize ||
+	    (tftp_window_map &&
+	     ((ushort)(block - tftp_last_ack) >= tftp_windowsize ||
+	      (tftp_final_block_seen && block == tftp_final_block)))) {
+		tftp_send();
+		tftp_last_ack = tftp_prev_block;
+	}
+}
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
@@ -539,6 +891,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (i + 11 < len &&
+			    strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				if (tftp_windowsize < 1 ||
+				    tftp_windowsize > tftp_windowsize_option)
+					tftp_windowsize = 1;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -550,6 +913,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len - 1);
+		if (tftp_mcast_active)
+			tftp_windowsize = 1;
 		if ((tftp_mcast_active) && (!tftp_mcast_master_client))
 			tftp_state = STATE_DATA;	/* passive.. */
 		else
@@ -560,6 +925,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_state = STATE_DATA;
 			tftp_cur_block++;
 		}
+#endif
+#ifdef TFTP_RX_PLACE
+		tftp_place_start();
 #endif
 		tftp_send(); /* Send ACK or first data block */
 		break;
@@ -569,6 +937,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		len -= 2;
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
+		if (tftp_windowsize > 1) {
+			if (tftp_state == STATE_OACK) {
+				/* first block received */
+				tftp_state = STATE_DATA;
+				tftp_remote_port = src;
+				new_transfer();
+			}
+			tftp_window_data(pkt + 2, len);
+			break;
+		}
+
 		update_block_number();
 
 		if (tftp_state == STATE_SEND_RRQ)
@@ -691,6 +1070,9 @@ static void tftp_timeout_handler(void)
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
+		/* the re-ack starts the server's next window */
+		if (tftp_state == STATE_DATA)
+			tftp_last_ack = tftp_prev_block;
 	}
 }
 
@@ -709,6 +1091,18 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		tftp_windowsize_option = simple_strtol(ep, NULL, 10);
+
+	if (tftp_windowsize_option < 1)
+		tftp_windowsize_option = 1;
+	if (tftp_windowsize_option > TFTP_MAX_WINDOWSIZE) {
+		printf("TFTP windowsize (%d) too large, set max = %d\n",
+		       tftp_windowsize_option, TFTP_MAX_WINDOWSIZE);
+		tftp_windowsize_option = TFTP_MAX_WINDOWSIZE;
+	}
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -730,8 +1124,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (net_boot_file_name[0] == '\0') {
@@ -831,8 +1225,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -840,6 +1235,10 @@ void tftp_start(enum proto_t protocol)
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
 #endif
+#ifdef TFTP_RX_PLACE
+	tftp_place_active = 0;
+	net_set_rx_placer(NULL);
+#endif
 
 	tftp_send();
 }
@@ -860,8 +1259,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
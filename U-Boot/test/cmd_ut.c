@@ -22,6 +22,9 @@ static cmd_tbl_t cmd_ut_sub[] = {
 #ifdef CONFIG_UT_TIME
 	U_BOOT_CMD_MKENT(time, CONFIG_SYS_MAXARGS, 1, do_ut_time, "", ""),
 #endif
+#ifdef CONFIG_UT_STRING
+	U_BOOT_CMD_MKENT(string, CONFIG_SYS_MAXARGS, 1, do_ut_string, "", ""),
+#endif
 };
 
 static int do_ut_all(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
@@ -70,6 +73,9 @@ static char ut_help_text[] =
 #endif
 #ifdef CONFIG_UT_TIME
 	"ut time - Very basic test of time functions\n"
+#endif
+#ifdef CONFIG_UT_STRING
+	"ut string - Test memcpy(), memmove() and memset()\n"
 #endif
 	;
 #endif
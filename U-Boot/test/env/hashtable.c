@@ -0,0 +1,168 @@
+/*
+ * Tests for the hash table behind the environment
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <environment.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+
+static const char *htab_get(struct hsearch_data *htab, const char *key)
+{
+	ENTRY e, *ep;
+
+	e.key = key;
+	e.data = NULL;
+	hsearch_r(e, FIND, &ep, htab, 0);
+
+	return ep ? ep->data : NULL;
+}
+
+static int htab_set(struct hsearch_data *htab, const char *key,
+		    const char *data)
+{
+	ENTRY e, *ep;
+
+	e.key = key;
+	e.data = (char *)data;
+	hsearch_r(e, ENTER, &ep, htab, 0);
+
+	return ep ? 0 : -1;
+}
+
+/* Imported entries share the imported text until they are changed */
+static int env_test_htab_import(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = { .table = NULL };
+	char env[256] = "bootcmd_mmc0=run a\0bootcmd_mmc1=run b\0x=1\0";
+
+	ut_assert(himport_r(&htab, env, sizeof(env), '\0', 0, 0, 0, NULL));
+	/* The caller's buffer is not used after the import */
+	memset(env, 'z', sizeof(env));
+
+	ut_asserteq_str("run a", htab_get(&htab, "bootcmd_mmc0"));
+	ut_asserteq_str("run b", htab_get(&htab, "bootcmd_mmc1"));
+	ut_asserteq_ptr(NULL, htab_get(&htab, "bootcmd_mmc2"));
+
+	ut_assertok(htab_set(&htab, "x", "2"));
+	ut_asserteq_str("2", htab_get(&htab, "x"));
+	ut_assertok(htab_set(&htab, "x", "3"));
+	ut_asserteq_str("3", htab_get(&htab, "x"));
+
+	ut_assert(hdelete_r("bootcmd_mmc1", &htab, 0));
+	ut_asserteq_ptr(NULL, htab_get(&htab, "bootcmd_mmc1"));
+	ut_assertok(htab_set(&htab, "bootcmd_mmc1", "run c"));
+	ut_asserteq_str("run c", htab_get(&htab, "bootcmd_mmc1"));
+
+	strcpy(env, "y=5\nbootcmd_mmc0=changed\nx=\n");
+	ut_assert(himport_r(&htab, env, strlen(env), '\n', H_NOCLEAR, 0, 0,
+			    NULL));
+	ut_asserteq_str("5", htab_get(&htab, "y"));
+	ut_asserteq_str("changed", htab_get(&htab, "bootcmd_mmc0"));
+	ut_asserteq_ptr(NULL, htab_get(&htab, "x"));
+	ut_asserteq_str("run c", htab_get(&htab, "bootcmd_mmc1"));
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_import, 0);
+
+/* Names that only differ at the end are told apart */
+static int env_test_htab_prefix(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = { .table = NULL };
+	char key[32], data[16];
+	int i;
+
+	ut_assert(hcreate_r(512, &htab));
+	for (i = 0; i < 200; i++) {
+		sprintf(key, "bootcmd_longprefix_%d", i);
+		sprintf(data, "%d", i * 7);
+		ut_assertok(htab_set(&htab, key, data));
+	}
+	for (i = 0; i < 200; i++) {
+		sprintf(key, "bootcmd_longprefix_%d", i);
+		sprintf(data, "%d", i * 7);
+		ut_asserteq_str(data, htab_get(&htab, key));
+	}
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_prefix, 0);
+
+/* Imported text is freed once no entry points into it */
+static int env_test_htab_import_free(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = { .table = NULL };
+	char env[] = "a=1\0x=1\0";
+	struct mallinfo start, end;
+	int i;
+
+	ut_assert(himport_r(&htab, env, sizeof(env), '\0', 0, 0, 0, NULL));
+
+	start = mallinfo();
+	for (i = 0; i < 100; i++) {
+		char var[] = "x=2\n";
+
+		ut_assert(himport_r(&htab, var, strlen(var), '\n', H_NOCLEAR,
+				    0, 0, NULL));
+	}
+	end = mallinfo();
+	ut_asserteq_str("2", htab_get(&htab, "x"));
+	ut_asserteq_str("1", htab_get(&htab, "a"));
+	/* only the text 'x' points into now is left over */
+	ut_assert(end.uordblks - start.uordblks < 64);
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_import_free, 0);
+
+/* The default environment reads back as built, also after changes */
+static int env_test_htab_default(struct unit_test_state *uts)
+{
+	struct hsearch_data htab = { .table = NULL };
+	const char *env = (const char *)default_environment;
+	const char *p, *value;
+	char name[64];
+	int len;
+
+	ut_assert(himport_r(&htab, env, ENV_SIZE, '\0', 0, 0, 0, NULL));
+
+	for (p = env; *p; p += strlen(p) + 1) {
+		value = strchr(p, '=');
+		/* skip what himport_r() deletes or unescapes */
+		if (!value || !value[1] || strchr(value, '\\'))
+			continue;
+		len = value - p;
+		if (len >= sizeof(name))
+			continue;
+		memcpy(name, p, len);
+		name[len] = '\0';
+		value++;
+
+		ut_asserteq_str(value, htab_get(&htab, name));
+		ut_assertok(htab_set(&htab, name, "changed"));
+		ut_asserteq_str("changed", htab_get(&htab, name));
+		ut_assertok(htab_set(&htab, name, value));
+		ut_asserteq_str(value, htab_get(&htab, name));
+		ut_assert(hdelete_r(name, &htab, 0));
+		ut_asserteq_ptr(NULL, htab_get(&htab, name));
+		ut_assertok(htab_set(&htab, name, value));
+		ut_asserteq_str(value, htab_get(&htab, name));
+	}
+
+	hdestroy_r(&htab);
+
+	return 0;
+}
+ENV_TEST(env_test_htab_default, 0);
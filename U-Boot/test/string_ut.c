@@ -0,0 +1,161 @@
+/*
+ * Tests for memcpy(), memmove() and memset()
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+
+/* Large enough for the block loops, and for DC ZVA in memset() */
+#define BUF_SIZE	4096
+#define MAX_ALIGN	16
+#define GUARD		64
+#define TOTAL		(GUARD + MAX_ALIGN + BUF_SIZE + GUARD)
+
+static u8 buf[TOTAL];
+static u8 src_buf[TOTAL];
+static u8 expect[TOTAL];
+
+/* Lengths around every size boundary of the implementations */
+static const int lengths[] = {
+	0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65,
+	80, 127, 128, 129, 191, 255, 256, 257, 300, 511, 512, 1000, 1024,
+	2047, 2049, 3000, BUF_SIZE,
+};
+
+static void fill(u8 *p, int len, unsigned int seed)
+{
+	while (len--) {
+		seed = seed * 1103515245 + 12345;
+		*p++ = seed >> 16;
+	}
+}
+
+/* Byte-wise copy into expect[] */
+static void ref_copy(int dst, const u8 *src, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		expect[dst + i] = src[i];
+}
+
+static int check(const char *func, int len, int dst, int src)
+{
+	int i;
+
+	for (i = 0; i < TOTAL; i++) {
+		if (buf[i] != expect[i]) {
+			printf("%s: len=%d dst=%d src=%d: byte %d is %02x, expected %02x\n",
+			       func, len, dst, src, i, buf[i], expect[i]);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int test_memcpy(void)
+{
+	int i, d, s, len;
+	void *ret;
+
+	for (i = 0; i < ARRAY_SIZE(lengths); i++) {
+		len = lengths[i];
+		for (d = GUARD; d < GUARD + MAX_ALIGN; d++) {
+			for (s = GUARD; s < GUARD + MAX_ALIGN; s++) {
+				fill(buf, TOTAL, len + d);
+				fill(src_buf, TOTAL, len + s + 1);
+				ref_copy(0, buf, TOTAL);
+				ref_copy(d, src_buf + s, len);
+
+				ret = memcpy(buf + d, src_buf + s, len);
+				if (ret != buf + d) {
+					printf("%s: wrong return value\n",
+					       __func__);
+					return -EINVAL;
+				}
+				if (check(__func__, len, d, s))
+					return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int test_memmove(void)
+{
+	int i, d, s, len;
+	void *ret;
+
+	/* Overlapping in both directions, by less and more than a block */
+	for (i = 0; i < ARRAY_SIZE(lengths); i++) {
+		len = lengths[i];
+		if (len > BUF_SIZE - 2 * MAX_ALIGN)
+			continue;
+		for (d = GUARD; d < GUARD + 3 * MAX_ALIGN; d++) {
+			for (s = GUARD; s < GUARD + 3 * MAX_ALIGN; s += 5) {
+				fill(buf, TOTAL, len + d + s);
+				ref_copy(0, buf, TOTAL);
+				ref_copy(d, buf + s, len);
+
+				ret = memmove(buf + d, buf + s, len);
+				if (ret != buf + d) {
+					printf("%s: wrong return value\n",
+					       __func__);
+					return -EINVAL;
+				}
+				if (check(__func__, len, d, s))
+					return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int test_memset(void)
+{
+	int i, d, c, k, len;
+	void *ret;
+
+	for (i = 0; i < ARRAY_SIZE(lengths); i++) {
+		len = lengths[i];
+		for (d = GUARD; d < GUARD + MAX_ALIGN; d++) {
+			/* zero takes its own path, and only the low byte counts */
+			for (c = 0; c <= 0x1a5; c += 0xa5) {
+				fill(buf, TOTAL, len + d + c);
+				ref_copy(0, buf, TOTAL);
+				for (k = 0; k < len; k++)
+					expect[d + k] = c;
+
+				ret = memset(buf + d, c, len);
+				if (ret != buf + d) {
+					printf("%s: wrong return value\n",
+					       __func__);
+					return -EINVAL;
+				}
+				if (check(__func__, len, d, c))
+					return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int do_ut_string(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	int ret = 0;
+
+	ret |= test_memcpy();
+	ret |= test_memmove();
+	ret |= test_memset();
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
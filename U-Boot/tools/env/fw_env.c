@@ -112,6 +112,35 @@ static int env_aes_cbc_crypt(char *data, const int enc);
 
 static int HaveRedundEnv = 0;
 
+/*
+ * U-Boot's log of changes to the environment, see common/env_mmc.c: an
+ * empty first record names the environment it applies to by its CRC and
+ * the log by a number, and each record after it that carries both holds
+ * "name=value" and "name" (delete) items. On a block device or file only.
+ */
+struct envlog_s {
+	const char *devname;		/* Device name, NULL if no log */
+	ulong devoff;			/* Device offset */
+	ulong size;			/* log size */
+	ulong blksz;			/* records are padded to this */
+};
+
+static struct envlog_s envlog;
+
+#define ENV_LOG_MAGIC	0x676f4c45	/* "ELog" */
+
+struct env_log_rec {
+	uint32_t	magic;
+	uint32_t	gen;		/* of the log */
+	uint32_t	base_crc;	/* of the environment it applies to */
+	uint32_t	len;		/* of text[] */
+	uint32_t	crc;		/* of the above and text[] */
+	char		text[];
+};
+
+/* Log records hold changes that U-Boot has accepted already */
+static int env_log_replaying;
+
 static unsigned char active_flag = 1;
 /* obsolete_flag must be 0 to efficiently set it on NOR flash without erasing */
 static unsigned char obsolete_flag = 0;
@@ -122,6 +151,8 @@ static unsigned char obsolete_flag = 0;
 static int flash_io (int mode);
 static char *envmatch (char * s1, char * s2);
 static int parse_config (void);
+static int env_log_replay(void);
+static int env_log_clear(void);
 
 #if defined(CONFIG_FILE)
 static int get_config (char *);
@@ -340,6 +371,11 @@ int fw_printenv (int argc, char *argv[])
 int fw_env_close(void)
 {
 	int ret;
+
+	/* The log must not apply to the new environment, see env_mmc.c */
+	if (envlog.devname && env_log_clear())
+		return -1;
+
 	if (aes_flag) {
 		ret = env_aes_cbc_crypt(environment.data, 1);
 		if (ret) {
@@ -398,7 +434,9 @@ int fw_env_write(char *name, char *value)
 	overwriting = (oldval && (value && strlen(value)));
 
 	/* check for permission */
-	if (deleting) {
+	if (env_log_replaying && (deleting || creating || overwriting)) {
+		/* Accepted already */
+	} else if (deleting) {
 		if (env_flags_validate_varaccess(name,
 		    ENV_FLAGS_VARACCESS_PREVENT_DELETE)) {
 			printf("Can't delete \"%s\"\n", name);
@@ -1182,6 +1220,136 @@ exit:
 	return rc;
 }
 
+static uint32_t env_log_crc(const struct env_log_rec *rec)
+{
+	uint32_t crc;
+
+	crc = crc32(0, (const uint8_t *)rec, offsetof(struct env_log_rec, crc));
+
+	return crc32(crc, (const uint8_t *)rec->text, rec->len);
+}
+
+static uint32_t env_log_rec_size(uint32_t len)
+{
+	return DIV_ROUND_UP(sizeof(struct env_log_rec) + len, envlog.blksz) *
+		envlog.blksz;
+}
+
+/* The record at 'pos' of the log, if it belongs to a log for 'base_crc' */
+static struct env_log_rec *env_log_get(char *log, uint32_t pos,
+				       uint32_t base_crc)
+{
+	struct env_log_rec *rec = (struct env_log_rec *)(log + pos);
+
+	if (pos + sizeof(*rec) > envlog.size ||
+	    rec->magic != ENV_LOG_MAGIC || rec->base_crc != base_crc ||
+	    rec->len > envlog.size - pos - sizeof(*rec) ||
+	    env_log_crc(rec) != rec->crc)
+		return NULL;
+
+	return rec;
+}
+
+/* Apply the log to the environment just read, as U-Boot does */
+static int env_log_replay(void)
+{
+	struct env_log_rec *rec;
+	char *log, *item, *next, *end, *val;
+	uint32_t gen, pos;
+	int fd, rc = -1;
+
+	log = malloc(envlog.size);
+	if (!log) {
+		fprintf(stderr, "Not enough memory for the log (%ld bytes)\n",
+			envlog.size);
+		return -1;
+	}
+
+	fd = open(envlog.devname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", envlog.devname,
+			strerror(errno));
+		goto out;
+	}
+	if (lseek(fd, envlog.devoff, SEEK_SET) == -1 ||
+	    read(fd, log, envlog.size) != envlog.size) {
+		fprintf(stderr, "Read error on %s: %s\n", envlog.devname,
+			strerror(errno));
+		close(fd);
+		goto out;
+	}
+	close(fd);
+
+	rc = 0;
+	rec = env_log_get(log, 0, *environment.crc);
+	if (!rec || rec->len)
+		goto out;
+	gen = rec->gen;
+
+	env_log_replaying = 1;
+	for (pos = env_log_rec_size(0);
+	     (rec = env_log_get(log, pos, *environment.crc)) && rec->gen == gen;
+	     pos += env_log_rec_size(rec->len)) {
+		end = rec->text + rec->len;
+		for (item = rec->text; item < end && *item; item = next) {
+			next = memchr(item, '\0', end - item);
+			if (!next)
+				break;
+			next++;
+			val = strchr(item, '=');
+			if (val)
+				*val++ = '\0';
+			rc = fw_env_write(item, val);
+			if (rc)
+				goto out;
+		}
+	}
+#ifdef DEBUG
+	fprintf(stderr, "Log replayed up to 0x%x\n", pos);
+#endif
+
+out:
+	env_log_replaying = 0;
+	free(log);
+	return rc;
+}
+
+/* Zero the first record of the log, so that it applies to nothing */
+static int env_log_clear(void)
+{
+	char *blk;
+	int fd, rc = -1;
+
+	blk = calloc(1, envlog.blksz);
+	if (!blk)
+		return -1;
+
+	fd = open(envlog.devname, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", envlog.devname,
+			strerror(errno));
+		goto out;
+	}
+	if (lseek(fd, envlog.devoff, SEEK_SET) == -1 ||
+	    write(fd, blk, envlog.blksz) != envlog.blksz ||
+	    fsync(fd)) {
+		fprintf(stderr, "Write error on %s: %s\n", envlog.devname,
+			strerror(errno));
+		close(fd);
+		goto out;
+	}
+	if (close(fd)) {
+		fprintf(stderr, "I/O error on %s: %s\n", envlog.devname,
+			strerror(errno));
+		goto out;
+	}
+	rc = 0;
+
+out:
+	free(blk);
+	return rc;
+}
+
 /*
  * s1 is either a simple 'name', or a 'name=value' pair.
  * s2 is a 'name=value' pair.
@@ -1214,6 +1382,7 @@ int fw_env_open(void)
 	unsigned char flag1;
 	void *addr1;
 
+	int crc_ok = 1;
 	int ret;
 
 	struct env_image_single *single;
@@ -1222,6 +1391,11 @@ int fw_env_open(void)
 	if (parse_config ())		/* should fill envdevices */
 		return -1;
 
+	if (envlog.devname && aes_flag) {
+		fprintf(stderr, "The environment log does not support AES\n");
+		return -1;
+	}
+
 	addr0 = calloc(1, CUR_ENVSIZE);
 	if (addr0 == NULL) {
 		fprintf(stderr,
@@ -1264,6 +1438,7 @@ int fw_env_open(void)
 				"Warning: Bad CRC, using default environment\n");
 			memcpy(environment.data, default_environment, sizeof default_environment);
 		}
+		crc_ok = crc0_ok;
 	} else {
 		flag0 = *environment.flags;
 
@@ -1327,6 +1502,7 @@ int fw_env_open(void)
 			memcpy (environment.data, default_environment,
 				sizeof default_environment);
 			dev_current = 0;
+			crc_ok = 0;
 		} else {
 			switch (environment.flag_scheme) {
 			case FLAG_BOOLEAN:
@@ -1382,6 +1558,11 @@ int fw_env_open(void)
 		fprintf(stderr, "Selected env in %s\n", DEVNAME(dev_current));
 #endif
 	}
+
+	/* U-Boot applies the log only to an environment it could load */
+	if (envlog.devname && crc_ok)
+		return env_log_replay();
+
 	return 0;
 }
 
@@ -1428,6 +1609,15 @@ static int parse_config ()
 #endif
 	HaveRedundEnv = 1;
 #endif
+#ifdef LOG_DEVICE_NAME
+	envlog.devname = LOG_DEVICE_NAME;
+	envlog.devoff = LOG_OFFSET;
+	envlog.size = LOG_SIZE;
+	envlog.blksz = 512;
+#ifdef LOG_BLKSZ
+	envlog.blksz = LOG_BLKSZ;
+#endif
+#endif
 #endif
 	if (stat (DEVNAME (0), &st)) {
 		fprintf (stderr,
@@ -1442,6 +1632,20 @@ static int parse_config ()
 			DEVNAME (1), strerror (errno));
 		return -1;
 	}
+
+	if (envlog.devname) {
+		if (stat(envlog.devname, &st)) {
+			fprintf(stderr, "Cannot access log device %s: %s\n",
+				envlog.devname, strerror(errno));
+			return -1;
+		}
+		if (!envlog.blksz || envlog.size < envlog.blksz ||
+		    S_ISCHR(st.st_mode)) {
+			fprintf(stderr, "Unsupported log on %s\n",
+				envlog.devname);
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -1458,11 +1662,25 @@ static int get_config (char *fname)
 	if (fp == NULL)
 		return -1;
 
-	while (i < 2 && fgets (dump, sizeof (dump), fp)) {
+	while (fgets (dump, sizeof (dump), fp)) {
 		/* Skip incomplete conversions and comment strings */
 		if (dump[0] == '#')
 			continue;
 
+		/* "log" device offset size [block size] */
+		if (!strncmp(dump, "log", 3) && WHITESPACE(dump[3])) {
+			envlog.blksz = 512;
+			rc = sscanf(dump + 3, "%ms %lx %lx %lx", &devname,
+				    &envlog.devoff, &envlog.size,
+				    &envlog.blksz);
+			if (rc >= 3)
+				envlog.devname = devname;
+			continue;
+		}
+
+		if (i == 2)
+			continue;
+
 		rc = sscanf (dump, "%ms %lx %lx %lx %lx",
 			     &devname,
 			     &DEVOFFSET (i),
@@ -0,0 +1,228 @@
+/*
+ * Build the default environment into a perfect hash table, so that
+ * lib/hashtable.c finds its variables with one probe and leaves the
+ * values nobody changes in read-only memory (CONFIG_ENV_DEFAULT_HASH).
+ *
+ * The names are spread over buckets by their hash. Going from the
+ * fullest bucket down, each gets the first displacement which sends
+ * all of its names to places still free (hash and displace).
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef __ASSEMBLY__
+#define	__ASSEMBLY__			/* Dirty trick to get only #defines	*/
+#endif
+#define	__ASM_STUB_PROCESSOR_H__	/* don't include asm/processor.		*/
+#include <config.h>
+#undef	__ASSEMBLY__
+
+#include <linux/stringify.h>
+#include <env_hash.h>
+
+#define DEFAULT_ENV_INSTANCE_STATIC
+#include <env_default.h>
+
+#define MAX_DISP	0x10000		/* displacements tried per bucket */
+
+struct var {
+	char *key;
+	char *data;
+	unsigned int hash;
+};
+
+static struct var *vars;
+static int nvars;
+
+static void *xmalloc(size_t size)
+{
+	void *p = calloc(1, size ? size : 1);
+
+	if (!p) {
+		fprintf(stderr, "envhash: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static int find_var(const char *key)
+{
+	int i;
+
+	for (i = 0; i < nvars; i++)
+		if (!strcmp(vars[i].key, key))
+			return i;
+	return -1;
+}
+
+/* Parse the default environment the way himport_r() does */
+static void parse_env(void)
+{
+	char *p = default_environment;
+	char *end = default_environment + sizeof(default_environment);
+	int i;
+
+	vars = xmalloc(sizeof(default_environment) * sizeof(*vars));
+
+	while (p < end && *p) {
+		char *next = p + strlen(p) + 1;
+		char *name, *value, *s, *d;
+
+		while (isblank(*p))
+			++p;
+		if (*p == '#' || !*p) {
+			p = next;
+			continue;
+		}
+
+		name = p;
+		value = strchr(name, '=');
+		if (value)
+			*value++ = '\0';
+
+		/* "name" and "name=" delete the variable */
+		i = find_var(name);
+		if (!value || !*value) {
+			if (i >= 0)
+				vars[i] = vars[--nvars];
+			p = next;
+			continue;
+		}
+
+		/* himport_r() drops the backslash of an escape */
+		for (s = d = value; *s; s++) {
+			if (*s == '\\' && s[1])
+				s++;
+			*d++ = *s;
+		}
+		*d = '\0';
+
+		if (i < 0)
+			i = nvars++;
+		vars[i].key = name;
+		vars[i].data = value;
+		vars[i].hash = env_hash(name);
+		p = next;
+	}
+}
+
+static void print_string(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if (isprint((unsigned char)*s) && *s != '?')
+			putchar(*s);
+		else
+			printf("\\%03o", (unsigned char)*s);
+	}
+	putchar('"');
+}
+
+/*
+ * Find a displacement for every bucket so that no two names share a
+ * place. Returns 0 on success, -1 if some bucket has none.
+ */
+static int place_vars(int nbuckets, int size, unsigned int *disp, int *slot)
+{
+	int *count = xmalloc(nbuckets * sizeof(*count));
+	int *order = xmalloc(nbuckets * sizeof(*order));
+	int *taken = xmalloc(size * sizeof(*taken));
+	int i, j, k, b, ret = 0;
+
+	for (i = 0; i < nvars; i++)
+		count[vars[i].hash % nbuckets]++;
+
+	/* fullest buckets first */
+	for (i = 0; i < nbuckets; i++) {
+		for (j = i; j > 0 && count[order[j - 1]] < count[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	for (i = 0; i < nbuckets && count[order[i]]; i++) {
+		b = order[i];
+		for (disp[b] = 0; disp[b] < MAX_DISP; disp[b]++) {
+			for (j = 0; j < nvars; j++) {
+				if (vars[j].hash % nbuckets != b)
+					continue;
+				k = env_hash_slot(vars[j].hash, disp[b], size);
+				if (taken[k])
+					break;
+				taken[k] = j + 1;
+				slot[j] = k;
+			}
+			if (j == nvars)
+				break;
+
+			/* give back what this try took */
+			for (k = 0; k < size; k++)
+				if (taken[k] && vars[taken[k] - 1].hash %
+				    nbuckets == b)
+					taken[k] = 0;
+		}
+		if (disp[b] == MAX_DISP) {
+			ret = -1;
+			break;
+		}
+	}
+
+	free(count);
+	free(order);
+	free(taken);
+	return ret;
+}
+
+int main(void)
+{
+	int nbuckets, size, i, j;
+	unsigned int *disp;
+	int *slot;
+
+	parse_env();
+
+	nbuckets = nvars / 4 + 1;
+	size = nvars ? nvars : 1;
+	slot = xmalloc(nvars * sizeof(*slot));
+	disp = xmalloc(nbuckets * sizeof(*disp));
+
+	/* a little more room when the names do not fit */
+	while (place_vars(nbuckets, size, disp, slot)) {
+		memset(disp, 0, nbuckets * sizeof(*disp));
+		size++;
+	}
+
+	printf("/* Generated by tools/envhash from the default environment */\n\n");
+	printf("#define ENV_DEFAULT_BUCKETS\t%d\n", nbuckets);
+	printf("#define ENV_DEFAULT_SLOTS\t%d\n\n", size);
+
+	printf("static const unsigned short env_default_disp[] = {\n");
+	for (i = 0; i < nbuckets; i++)
+		printf("\t%u,\n", disp[i]);
+	printf("};\n\n");
+
+	printf("static const struct env_default env_default_vars[] = {\n");
+	for (i = 0; i < size; i++) {
+		for (j = 0; j < nvars; j++)
+			if (slot[j] == i)
+				break;
+		if (j == nvars) {
+			printf("\t{ 0, NULL, NULL },\n");
+			continue;
+		}
+		printf("\t{ 0x%08x, ", vars[j].hash);
+		print_string(vars[j].key);
+		printf(",\n\t  ");
+		print_string(vars[j].data);
+		printf(" },\n");
+	}
+	printf("};\n");
+
+	return EXIT_SUCCESS;
+}